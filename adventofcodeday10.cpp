@@ -1,87 +1,27 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <random>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace std;
 
-// Robust Fraction Struct
-struct Fraction {
-	long long num;
-	long long den;
-
-	Fraction(long long n = 0, long long d = 1) {
-		if (d == 0) {
-			// Divide by zero panic handling or assume infinite?
-			// For this problem, we shouldn't hit it in normal math if careful.
-			d = 1;
-			n = 0; // Error state
-		}
-		if (d < 0) {
-			n = -n;
-			d = -d;
-		}
-		long long common = std::gcd(abs(n), d);
-		num = n / common;
-		den = d / common;
-	}
-
-	Fraction operator+(const Fraction& other) const {
-		// a/b + c/d = (ad + bc) / bd
-		// Optimize to use LCM?
-		long long common_den = std::lcm(den, other.den);
-		long long n =
-			num * (common_den / den) + other.num * (common_den / other.den);
-		return Fraction(n, common_den);
-	}
-
-	Fraction operator-(const Fraction& other) const {
-		long long common_den = std::lcm(den, other.den);
-		long long n =
-			num * (common_den / den) - other.num * (common_den / other.den);
-		return Fraction(n, common_den);
-	}
-
-	Fraction operator*(const Fraction& other) const {
-		return Fraction(num * other.num, den * other.den);
-	}
-
-	Fraction operator/(const Fraction& other) const {
-		return Fraction(num * other.den, den * other.num);
-	}
-
-	bool operator<(const Fraction& other) const {
-		return num * other.den < other.num * den;
-	}
-
-	bool operator>(const Fraction& other) const {
-		return num * other.den > other.num * den;
-	}
-
-	bool operator<=(const Fraction& other) const { return !(*this > other); }
-
-	bool operator>=(const Fraction& other) const { return !(*this < other); }
-
-	bool operator==(const Fraction& other) const {
-		return num == other.num && den == other.den;
-	}
-
-	bool is_integer() const { return den == 1; }
-
-	// Check if integer (within epsilon is removed)
-	long long to_long() const { return num / den; }
-
-	double to_double() const { return (double)num / den; }
-};
-
 struct Machine {
 	vector<int> target_pattern;
 	vector<vector<int>> buttons;
-	vector<int> joltage_requirements;
+	vector<long long> joltage_requirements;
 };
 
 Machine parse_machine(string line) {
@@ -119,16 +59,131 @@ Machine parse_machine(string line) {
 		stringstream ss(content);
 		string segment;
 		while (getline(ss, segment, ',')) {
-			m.joltage_requirements.push_back(stoi(segment));
+			m.joltage_requirements.push_back(stoll(segment));
 		}
 	}
 	return m;
 }
 
-int min_presses_p1 = -1;
+template <class F> void run_threads(int num_threads, F f) {
+	vector<thread> threads;
+	for (int t = 1; t < num_threads; ++t)
+		threads.emplace_back(f, t);
+	f(0);
+	for (thread& t : threads)
+		t.join();
+}
+
+// Work-stealing pool: every worker takes tasks from the back of its own
+// deque and, once that is empty, steals from the front of another worker's.
+// A running task may spawn more tasks onto its worker's deque; run() returns
+// when every task, spawned ones included, has finished.
+class WorkStealingPool {
+public:
+	using Task = function<void()>;
+
+	explicit WorkStealingPool(int num_threads) : queues(num_threads) {}
+
+	// Seeds tasks given in priority order, dealt out round robin so that
+	// each worker starts on the most important task it was given.
+	void schedule(vector<Task> tasks) {
+		for (size_t k = tasks.size(); k-- > 0;)
+			push(k % queues.size(), move(tasks[k]));
+	}
+
+	// Only valid from inside a running task.
+	void spawn(Task task) { push(worker_index, move(task)); }
+
+	// True while some worker is idle and nothing is waiting to be stolen,
+	// i.e. when a long task should hand part of its work off.
+	bool hungry() const {
+		return idle.load(memory_order_relaxed) > 0 &&
+			queued.load(memory_order_relaxed) == 0;
+	}
+
+	void run() {
+		run_threads(queues.size(), [&](int w) {
+			worker_index = w;
+			bool is_idle = false;
+			for (;;) {
+				Task task;
+				if (take(w, task)) {
+					if (is_idle) {
+						idle--;
+						is_idle = false;
+					}
+					task();
+					pending--;
+					continue;
+				}
+				if (pending.load() == 0)
+					break;
+				if (!is_idle) {
+					idle++;
+					is_idle = true;
+				}
+				this_thread::yield();
+			}
+			if (is_idle)
+				idle--;
+		});
+	}
+
+private:
+	struct Queue {
+		mutex lock;
+		deque<Task> tasks;
+	};
+
+	vector<Queue> queues;
+	atomic<int> pending{ 0 }; // pushed but not yet finished
+	atomic<int> queued{ 0 }; // sitting in a deque
+	atomic<int> idle{ 0 };
+	static thread_local int worker_index;
+
+	void push(int w, Task task) {
+		pending++;
+		lock_guard<mutex> guard(queues[w].lock);
+		queues[w].tasks.push_back(move(task));
+		queued++;
+	}
+
+	bool take(int w, Task& task) {
+		int n = queues.size();
+		for (int k = 0; k < n; ++k) {
+			Queue& q = queues[(w + k) % n];
+			lock_guard<mutex> guard(q.lock);
+			if (q.tasks.empty())
+				continue;
+			if (k == 0) {
+				task = move(q.tasks.back());
+				q.tasks.pop_back();
+			}
+			else {
+				task = move(q.tasks.front());
+				q.tasks.pop_front();
+			}
+			queued--;
+			return true;
+		}
+		return false;
+	}
+};
+
+thread_local int WorkStealingPool::worker_index = 0;
+
+// Lowers best to value, where -1 means nothing found yet; the result only
+// depends on the values offered, so the answer is the same whatever the
+// thread interleaving.
+void update_min(atomic<long long>& best, long long value) {
+	long long seen = best.load(memory_order_relaxed);
+	while ((seen == -1 || value < seen) &&
+		!best.compare_exchange_weak(seen, value, memory_order_relaxed)) {
+	}
+}
 
 void solve_part1_recursive(const Machine& m, int button_idx,
-	vector<int>& current_state, int current_presses) {
+	vector<int>& current_state, int current_presses, int& min_presses) {
 	if (button_idx == m.buttons.size()) {
 		bool match = true;
 		for (size_t i = 0; i < m.target_pattern.size(); ++i) {
@@ -138,24 +193,26 @@ void solve_part1_recursive(const Machine& m, int button_idx,
 			}
 		}
 		if (match) {
-			if (min_presses_p1 == -1 || current_presses < min_presses_p1) {
-				min_presses_p1 = current_presses;
+			if (min_presses == -1 || current_presses < min_presses) {
+				min_presses = current_presses;
 			}
 		}
 		return;
 	}
 
-	if (min_presses_p1 != -1 && current_presses >= min_presses_p1)
+	if (min_presses != -1 && current_presses >= min_presses)
 		return;
 
-	solve_part1_recursive(m, button_idx + 1, current_state, current_presses);
+	solve_part1_recursive(m, button_idx + 1, current_state, current_presses,
+		min_presses);
 
 	for (int idx : m.buttons[button_idx]) {
 		if (idx < current_state.size()) {
 			current_state[idx]++;
 		}
 	}
-	solve_part1_recursive(m, button_idx + 1, current_state, current_presses + 1);
+	solve_part1_recursive(m, button_idx + 1, current_state, current_presses + 1,
+		min_presses);
 	for (int idx : m.buttons[button_idx]) {
 		if (idx < current_state.size()) {
 			current_state[idx]--;
@@ -164,72 +221,686 @@ void solve_part1_recursive(const Machine& m, int button_idx,
 }
 
 int solve_part1(const Machine& m) {
-	min_presses_p1 = -1;
+	int min_presses = -1;
 	vector<int> current_state(m.target_pattern.size(), 0);
-	solve_part1_recursive(m, 0, current_state, 0);
-	return min_presses_p1;
+	solve_part1_recursive(m, 0, current_state, 0, min_presses);
+	return min_presses;
 }
 
-// Optimization for Part 2: Gauss-Jordan Elimination
-long long min_total_presses = -1;
+// Part 1 over GF(2): pressing a button twice is a no-op, so the presses form
+// a 0/1 vector x with A x = target (mod 2), one bit per button in a 64-bit
+// row per light. After elimination every solution is x0 plus a combination
+// of the nullspace vectors of the free buttons, and the answer is the
+// minimum weight among them.
+//
+// Only the pivot part of a solution varies with the combination: choosing a
+// set S of free buttons gives weight |S| + popcount(x0 ^ XOR syndrome(f)),
+// where syndrome(f) marks the pivot rows that free button f appears in.
+const int GF2_MAX_BUTTONS = 64;
+
+struct Gf2Reduced {
+	bool consistent = true;
+	int rank = 0;
+	vector<int> free_cols;
+	vector<unsigned long long> syndromes; // per free column, over pivot rows
+	unsigned long long x0 = 0; // pivot values with every free button off
+};
+
+// Gauss-Jordan elimination taking pivot columns in the given order.
+Gf2Reduced gf2_reduce(vector<unsigned long long> rows, vector<int> rhs,
+	const vector<int>& col_order) {
+	Gf2Reduced r;
+	int num_rows = rows.size();
+	vector<bool> is_pivot(64, false);
+	for (int col : col_order) {
+		if (r.rank == num_rows)
+			break;
+		int sel = -1;
+		for (int row = r.rank; row < num_rows; ++row) {
+			if (rows[row] >> col & 1) {
+				sel = row;
+				break;
+			}
+		}
+		if (sel == -1)
+			continue;
+		swap(rows[r.rank], rows[sel]);
+		swap(rhs[r.rank], rhs[sel]);
+		for (int row = 0; row < num_rows; ++row) {
+			if (row != r.rank && (rows[row] >> col & 1)) {
+				rows[row] ^= rows[r.rank];
+				rhs[row] ^= rhs[r.rank];
+			}
+		}
+		is_pivot[col] = true;
+		r.rank++;
+	}
+	for (int row = r.rank; row < num_rows; ++row) {
+		if (rhs[row])
+			r.consistent = false;
+	}
+	for (int i = 0; i < r.rank; ++i)
+		r.x0 |= (unsigned long long)rhs[i] << i;
+	for (int col : col_order) {
+		if (is_pivot[col])
+			continue;
+		unsigned long long syn = 0;
+		for (int i = 0; i < r.rank; ++i)
+			syn |= (rows[i] >> col & 1) << i;
+		r.free_cols.push_back(col);
+		r.syndromes.push_back(syn);
+	}
+	return r;
+}
 
-void solve_system_recursive(const vector<vector<Fraction>>& reduced_matrix,
-	const vector<int>& free_vars,
-	const vector<int>& pivot_vars,
-	const vector<long long>& global_bounds,
-	vector<long long>& current_solution,
-	int free_var_idx) {
+// All 2^free subsets in Gray-code order, one syndrome XOR per step.
+int gf2_enumerate(const vector<unsigned long long>& syndromes,
+	unsigned long long x0) {
+	int f = syndromes.size();
+	unsigned long long s = 0;
+	int best = __builtin_popcountll(x0);
+	int chosen = 0;
+	for (unsigned long long g = 1; g < (1ULL << f); ++g) {
+		int bit = __builtin_ctzll(g);
+		s ^= syndromes[bit];
+		chosen += ((g ^ (g >> 1)) >> bit & 1) ? 1 : -1;
+		best = min(best, chosen + __builtin_popcountll(x0 ^ s));
+	}
+	return best;
+}
 
-	// Pruning: Calculate current cost from already assigned free variables
-	long long current_cost = 0;
-	for (size_t f = 0; f < free_var_idx; ++f) {
-		current_cost += current_solution[free_vars[f]];
+// Breadth-first search over the 2^rank syndromes: the fewest free presses
+// reaching each one, then the cheapest completion.
+int gf2_syndrome_bfs(const vector<unsigned long long>& syndromes,
+	unsigned long long x0, int rank) {
+	vector<int> dist(1u << rank, -1);
+	vector<unsigned> queue = { 0 };
+	dist[0] = 0;
+	for (size_t head = 0; head < queue.size(); ++head) {
+		unsigned s = queue[head];
+		for (unsigned long long e : syndromes) {
+			unsigned t = s ^ (unsigned)e;
+			if (dist[t] == -1) {
+				dist[t] = dist[s] + 1;
+				queue.push_back(t);
+			}
+		}
+	}
+	int best = -1;
+	for (unsigned s : queue) {
+		int w = dist[s] + __builtin_popcountll(x0 ^ s);
+		if (best == -1 || w < best)
+			best = w;
 	}
+	return best;
+}
 
-	if (min_total_presses != -1 && current_cost >= min_total_presses)
+// Calls visit(mask) for every k-subset of the n low bits.
+template <class F> void for_each_subset(int n, int k, F visit) {
+	if (k > n)
 		return;
+	vector<int> idx(k);
+	iota(idx.begin(), idx.end(), 0);
+	for (;;) {
+		unsigned long long mask = 0;
+		for (int i : idx)
+			mask |= 1ULL << i;
+		visit(mask);
+		int pos = k - 1;
+		while (pos >= 0 && idx[pos] == n - k + pos)
+			--pos;
+		if (pos < 0)
+			return;
+		++idx[pos];
+		for (int i = pos + 1; i < k; ++i)
+			idx[i] = idx[i - 1] + 1;
+	}
+}
 
-	if (free_var_idx == free_vars.size()) {
-		// Calculate basic vars
-		bool valid = true;
-		long long temp_cost = current_cost;
+// Meet in the middle on the weight, for many free buttons and a high rank.
+// A second elimination prefers the first one's free columns as pivots, so the
+// two free sets F1 and F2 are (nearly) disjoint. An optimal x with weight W
+// has at most W/2 presses in one of them, so enumerating presses in F1 and
+// in F2 by increasing count t finds it by t = W/2; once both are done up to
+// t, anything missed weighs at least (t + 1) + (t + 1 - |F1 & F2|).
+int gf2_split_weight(const vector<unsigned long long>& rows,
+	const vector<int>& rhs, int num_buttons, const Gf2Reduced& first) {
+	vector<bool> in_first(num_buttons, false);
+	vector<int> order;
+	for (int col : first.free_cols) {
+		in_first[col] = true;
+		order.push_back(col);
+	}
+	for (int col = 0; col < num_buttons; ++col) {
+		if (!in_first[col])
+			order.push_back(col);
+	}
+	const Gf2Reduced second = gf2_reduce(rows, rhs, order);
+	int overlap = 0;
+	for (int col : second.free_cols)
+		overlap += in_first[col];
+
+	int best = __builtin_popcountll(first.x0);
+	int f = first.free_cols.size();
+	for (int t = 0; t <= f; ++t) {
+		for (const Gf2Reduced* r : { &first, &second }) {
+			for_each_subset(f, t, [&](unsigned long long mask) {
+				unsigned long long s = r->x0;
+				for (unsigned long long m = mask; m; m &= m - 1)
+					s ^= r->syndromes[__builtin_ctzll(m)];
+				best = min(best, t + __builtin_popcountll(s));
+			});
+		}
+		int missed = (t + 1) + max(0, t + 1 - overlap);
+		if (best <= missed)
+			break;
+	}
+	return best;
+}
 
-		for (size_t i = 0; i < pivot_vars.size(); ++i) {
-			int p_idx = pivot_vars[i];
-			Fraction val = reduced_matrix[i].back(); // RHS
-			for (size_t f = 0; f < free_vars.size(); ++f) {
-				int f_idx = free_vars[f];
-				val = val -
-					(reduced_matrix[i][f_idx] * Fraction(current_solution[f_idx]));
-			}
+int solve_part1_gf2(const Machine& m) {
+	int num_buttons = m.buttons.size();
+	int num_lights = m.target_pattern.size();
+
+	vector<unsigned long long> rows(num_lights, 0);
+	vector<int> rhs(m.target_pattern.begin(), m.target_pattern.end());
+	for (int j = 0; j < num_buttons; ++j) {
+		for (int idx : m.buttons[j]) {
+			if (idx < num_lights)
+				rows[idx] ^= 1ULL << j; // a repeated index cancels, as in mod 2
+		}
+	}
+	vector<int> order(num_buttons);
+	iota(order.begin(), order.end(), 0);
+	Gf2Reduced r = gf2_reduce(rows, rhs, order);
+	if (!r.consistent)
+		return -1;
+
+	// Few free buttons: enumerate them. Low rank: search the syndromes.
+	// Otherwise both are large, so split the weight.
+	const int ENUMERATE_LIMIT = 20;
+	const int BFS_LIMIT = 22;
+	if ((int)r.free_cols.size() <= ENUMERATE_LIMIT)
+		return gf2_enumerate(r.syndromes, r.x0);
+	if (r.rank <= BFS_LIMIT)
+		return gf2_syndrome_bfs(r.syndromes, r.x0, r.rank);
+	return gf2_split_weight(rows, rhs, num_buttons, r);
+}
+
+// Optimization for Part 2: Gauss-Jordan Elimination
+//
+// The elimination is fraction-free (Bareiss): every entry stays an integer
+// and each step divides exactly by the previous pivot, so entries stay the
+// size of minors of the 0/1 incidence matrix. Afterwards each pivot row reads
+// den * x_pivot = rhs - sum(coeff_f * x_f) over the free variables, with the
+// row divided by its content to keep den small. A pivot value is integral
+// exactly when one modulo says so.
+//
+// Everything is templated on the integer type. Machines run in long long
+// with every multiply and add checked by the compiler's overflow builtins;
+// only a machine that actually overflows is redone in __int128.
+
+// Checked arithmetic: clears ok instead of wrapping.
+template <class T> T mul_checked(T a, T b, bool& ok) {
+	T r;
+	if (__builtin_mul_overflow(a, b, &r))
+		ok = false;
+	return r;
+}
+
+template <class T> T add_checked(T a, T b, bool& ok) {
+	T r;
+	if (__builtin_add_overflow(a, b, &r))
+		ok = false;
+	return r;
+}
+
+template <class T> T sub_checked(T a, T b, bool& ok) {
+	T r;
+	if (__builtin_sub_overflow(a, b, &r))
+		ok = false;
+	return r;
+}
+
+// A long long whose checked helpers are plain operations, so the same
+// search can be timed without the overflow checks. Only bench_part2 uses it:
+// it wraps (undefined behaviour) where long long would have been promoted.
+struct Unchecked {
+	long long v = 0;
+
+	Unchecked() = default;
+	Unchecked(long long x) : v(x) {}
+	explicit operator long long() const { return v; }
+
+	Unchecked operator-() const { return -v; }
+	Unchecked& operator/=(Unchecked b) { v /= b.v; return *this; }
+	Unchecked operator--(int) { return v--; }
+	friend Unchecked operator+(Unchecked a, Unchecked b) { return a.v + b.v; }
+	friend Unchecked operator-(Unchecked a, Unchecked b) { return a.v - b.v; }
+	friend Unchecked operator*(Unchecked a, Unchecked b) { return a.v * b.v; }
+	friend Unchecked operator/(Unchecked a, Unchecked b) { return a.v / b.v; }
+	friend Unchecked operator%(Unchecked a, Unchecked b) { return a.v % b.v; }
+	friend bool operator==(Unchecked a, Unchecked b) { return a.v == b.v; }
+	friend bool operator!=(Unchecked a, Unchecked b) { return a.v != b.v; }
+	friend bool operator<(Unchecked a, Unchecked b) { return a.v < b.v; }
+	friend bool operator>(Unchecked a, Unchecked b) { return a.v > b.v; }
+	friend bool operator<=(Unchecked a, Unchecked b) { return a.v <= b.v; }
+	friend bool operator>=(Unchecked a, Unchecked b) { return a.v >= b.v; }
+};
+
+Unchecked mul_checked(Unchecked a, Unchecked b, bool&) { return a * b; }
+Unchecked add_checked(Unchecked a, Unchecked b, bool&) { return a + b; }
+Unchecked sub_checked(Unchecked a, Unchecked b, bool&) { return a - b; }
+
+template <class T> T abs_value(T a) { return a < 0 ? -a : a; }
+
+template <class T> T gcd_value(T a, T b) {
+	a = abs_value(a);
+	b = abs_value(b);
+	while (b != 0) {
+		T t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+template <class T> T floor_div(T a, T b) {
+	T q = a / b;
+	if ((a % b != 0) && ((a < 0) != (b < 0)))
+		q--;
+	return q;
+}
+
+template <class T> T ceil_div(T a, T b) { return -floor_div(-a, b); }
+
+template <class T> struct ReducedSystem {
+	int width = 0; // num_vars + 1, the last column is the RHS
+	vector<T> a; // pivot rows, flat, row-major
+	vector<T> den; // per pivot row, > 0
+	vector<int> pivot_vars;
+	vector<int> free_vars;
+	bool consistent = true;
+
+	const T* row(int i) const { return &a[(size_t)i * width]; }
+	T rhs(int i) const { return a[(size_t)i * width + width - 1]; }
+};
+
+// The elimination only depends on the wiring, and the RHS enters it
+// linearly, so it is run once on [A | I]: the identity block ends up as the
+// integer matrix E with reduced rhs = E * b for any joltage vector b. The
+// rows of E past the rank must map b to zero for the system to be consistent.
+template <class T> struct Elimination {
+	int num_vars = 0;
+	int num_eqs = 0;
+	vector<T> a; // num_eqs rows of num_vars coefficients, then that row of E
+	vector<int> pivot_vars; // pivot_vars[i] is the pivot column of row i
+	vector<int> free_vars;
+
+	int width() const { return num_vars + num_eqs; }
+	const T* row(int i) const { return &a[(size_t)i * width()]; }
+};
+
+// Clears ok if an entry overflows T.
+template <class T> Elimination<T> eliminate(const Machine& m, bool& ok) {
+	Elimination<T> e;
+	e.num_vars = m.buttons.size();
+	e.num_eqs = m.joltage_requirements.size();
+	int num_vars = e.num_vars;
+	int num_eqs = e.num_eqs;
+	int w = e.width();
+
+	vector<T>& mat = e.a;
+	mat.assign((size_t)num_eqs * w, 0);
+	for (int j = 0; j < num_vars; ++j) {
+		for (int row_idx : m.buttons[j]) {
+			if (row_idx < num_eqs)
+				mat[(size_t)row_idx * w + j] = 1;
+		}
+	}
+	for (int i = 0; i < num_eqs; ++i)
+		mat[(size_t)i * w + num_vars + i] = 1;
 
-			if (!val.is_integer()) {
-				valid = false;
+	int pivot_row = 0;
+	T prev_pivot = 1;
+	for (int col = 0; col < num_vars && pivot_row < num_eqs; ++col) {
+		int sel = -1;
+		for (int row = pivot_row; row < num_eqs; ++row) {
+			if (mat[(size_t)row * w + col] != 0) {
+				sel = row;
 				break;
 			}
-			long long int_val = val.to_long();
-			if (int_val < 0) {
-				valid = false;
-				break;
+		}
+		if (sel == -1)
+			continue;
+		if (sel != pivot_row) {
+			swap_ranges(mat.begin() + (size_t)sel * w,
+				mat.begin() + (size_t)(sel + 1) * w,
+				mat.begin() + (size_t)pivot_row * w);
+		}
+
+		T* prow = &mat[(size_t)pivot_row * w];
+		T p = prow[col];
+		for (int i = 0; i < num_eqs; ++i) {
+			if (i == pivot_row)
+				continue;
+			T* r = &mat[(size_t)i * w];
+			T factor = r[col];
+			for (int j = 0; j < w; ++j) {
+				r[j] = sub_checked(mul_checked(p, r[j], ok),
+					mul_checked(factor, prow[j], ok), ok) / prev_pivot;
 			}
-			if (int_val > global_bounds[p_idx]) {
-				valid = false;
-				break;
-			} // Check global upper bound
+		}
+		if (!ok)
+			return e;
+		prev_pivot = p;
+		e.pivot_vars.push_back(col);
+		pivot_row++;
+	}
+
+	vector<bool> is_pivot(num_vars, false);
+	for (int col : e.pivot_vars)
+		is_pivot[col] = true;
+	for (int j = 0; j < num_vars; ++j) {
+		if (!is_pivot[j])
+			e.free_vars.push_back(j);
+	}
+	return e;
+}
 
-			current_solution[p_idx] = int_val;
-			temp_cost += int_val;
+// Applies an elimination to the joltages of m. Clears ok if an entry
+// overflows T.
+template <class T>
+ReducedSystem<T> apply_elimination(const Elimination<T>& e, const Machine& m,
+	bool& ok) {
+	int num_vars = e.num_vars;
+	int rank = e.pivot_vars.size();
+	ReducedSystem<T> sys;
+	sys.width = num_vars + 1;
+	sys.pivot_vars = e.pivot_vars;
+	sys.free_vars = e.free_vars;
+	int w = sys.width;
+
+	auto reduced_rhs = [&](int i) {
+		const T* r = e.row(i) + num_vars;
+		T v = 0;
+		for (int k = 0; k < e.num_eqs; ++k) {
+			if (r[k] != 0) {
+				v = add_checked(v,
+					mul_checked(r[k], (T)m.joltage_requirements[k], ok), ok);
+			}
 		}
+		return v;
+	};
+
+	for (int i = rank; i < e.num_eqs; ++i) {
+		if (reduced_rhs(i) != 0)
+			sys.consistent = false; // Inconsistent system
+	}
+
+	// Only the pivot rows are kept, each scaled to a positive pivot and
+	// divided by its content.
+	sys.a.resize((size_t)rank * w);
+	sys.den.resize(rank);
+	for (int i = 0; i < rank; ++i) {
+		T* r = &sys.a[(size_t)i * w];
+		copy(e.row(i), e.row(i) + num_vars, r);
+		r[num_vars] = reduced_rhs(i);
+		T g = 0;
+		for (int j = 0; j < w; ++j)
+			g = gcd_value(g, r[j]);
+		if (r[sys.pivot_vars[i]] < 0)
+			g = -g;
+		for (int j = 0; j < w; ++j)
+			r[j] /= g;
+		sys.den[i] = r[sys.pivot_vars[i]];
+	}
+	return sys;
+}
+
+// Clears ok if an entry overflows T.
+template <class T> ReducedSystem<T> reduce_system(const Machine& m, bool& ok) {
+	Elimination<T> e = eliminate<T>(m, ok);
+	if (!ok)
+		return ReducedSystem<T>();
+	return apply_elimination(e, m, ok);
+}
+
+// Buttons with their counter lists sorted and deduplicated, and out of range
+// counters dropped, then the buttons themselves sorted. Button order does
+// not change the minimum number of presses, so machines whose wiring only
+// differs by it share one elimination.
+Machine canonical_machine(const Machine& m) {
+	Machine c = m;
+	for (vector<int>& b : c.buttons) {
+		b.erase(remove_if(b.begin(), b.end(),
+			[&](int i) { return i < 0 || i >= (int)m.joltage_requirements.size(); }),
+			b.end());
+		sort(b.begin(), b.end());
+		b.erase(unique(b.begin(), b.end()), b.end());
+	}
+	sort(c.buttons.begin(), c.buttons.end());
+	return c;
+}
 
-		if (valid) {
-			if (min_total_presses == -1 || temp_cost < min_total_presses) {
-				min_total_presses = temp_cost;
+string wiring_key(const Machine& canonical) {
+	string key = to_string(canonical.joltage_requirements.size()) + ":";
+	for (const vector<int>& b : canonical.buttons) {
+		key += '(';
+		for (size_t k = 0; k < b.size(); ++k)
+			key += (k ? "," : "") + to_string(b[k]);
+		key += ')';
+	}
+	return key;
+}
+
+// Eliminations keyed by canonical wiring, so repeated wirings only pay for
+// E * b. Not thread safe: main fills it before the machines are solved. The
+// file format is one entry per key: the key line, a line
+// "num_eqs num_vars rank pivot_vars...", then num_eqs rows of [A | E].
+class EliminationCache {
+public:
+	long long hits = 0;
+	long long misses = 0;
+
+	// Returns null if the elimination overflows long long.
+	const Elimination<long long>* get(const Machine& canonical) {
+		string key = wiring_key(canonical);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			hits++;
+			return &it->second;
+		}
+		misses++;
+		bool ok = true;
+		Elimination<long long> e = eliminate<long long>(canonical, ok);
+		if (!ok)
+			return nullptr;
+		return &(entries[key] = move(e));
+	}
+
+	// A missing file is an empty cache. Returns false, leaving the cache
+	// unchanged, if any entry is malformed or does not have the shape its
+	// key describes.
+	bool load(const string& filename) {
+		ifstream in(filename);
+		if (!in)
+			return true;
+		map<string, Elimination<long long>> loaded;
+		string key;
+		while (getline(in, key)) {
+			if (key.empty())
+				continue;
+			Elimination<long long> e;
+			int key_eqs, key_vars, rank;
+			if (!key_shape(key, key_eqs, key_vars) ||
+				!(in >> e.num_eqs >> e.num_vars >> rank) ||
+				e.num_eqs != key_eqs || e.num_vars != key_vars || rank < 0 ||
+				rank > min(e.num_eqs, e.num_vars))
+				return false;
+			// Bareiss picks pivot columns left to right.
+			e.pivot_vars.resize(rank);
+			for (int k = 0; k < rank; ++k) {
+				int& col = e.pivot_vars[k];
+				if (!(in >> col) || col < 0 || col >= e.num_vars ||
+					(k > 0 && col <= e.pivot_vars[k - 1]))
+					return false;
+			}
+			size_t values = (size_t)e.num_eqs * e.width();
+			for (size_t k = 0; k < values; ++k) {
+				long long v;
+				if (!(in >> v))
+					return false;
+				e.a.push_back(v);
+			}
+			for (int i = 0; i < rank; ++i) {
+				if (e.row(i)[e.pivot_vars[i]] == 0)
+					return false;
 			}
+			vector<bool> is_pivot(e.num_vars, false);
+			for (int col : e.pivot_vars)
+				is_pivot[col] = true;
+			for (int j = 0; j < e.num_vars; ++j) {
+				if (!is_pivot[j])
+					e.free_vars.push_back(j);
+			}
+			loaded[key] = move(e);
+			in.ignore(numeric_limits<streamsize>::max(), '\n');
+		}
+		entries.swap(loaded);
+		return true;
+	}
+
+	bool save(const string& filename) const {
+		ofstream out(filename);
+		for (const auto& [key, e] : entries) {
+			out << key << "\n" << e.num_eqs << " " << e.num_vars << " "
+				<< e.pivot_vars.size();
+			for (int col : e.pivot_vars)
+				out << " " << col;
+			out << "\n";
+			for (int i = 0; i < e.num_eqs; ++i) {
+				for (int j = 0; j < e.width(); ++j)
+					out << (j ? " " : "") << e.row(i)[j];
+				out << "\n";
+			}
+		}
+		return (bool)out;
+	}
+
+private:
+	map<string, Elimination<long long>> entries;
+
+	// Counter and button counts of a wiring_key(); false if it is malformed.
+	static bool key_shape(const string& key, int& num_eqs, int& num_vars) {
+		size_t colon = key.find(':');
+		if (colon == 0 || colon > 9 ||
+			key.find_first_not_of("0123456789") != colon)
+			return false;
+		num_eqs = stoi(key.substr(0, colon));
+		num_vars = count(key.begin() + colon, key.end(), '(');
+		return true;
+	}
+};
+
+// Search state of one machine. The search tree may be split into several
+// pool tasks, which share the best total found so far (-1 while none is).
+//
+// prepare_search() lays out what every node needs as O(pivots) lookups: the
+// column of each free variable, and for each depth the sums over the free
+// variables still unassigned of min(0, coeff * bound) and max(0, coeff *
+// bound) per pivot row, kept as suffix sums.
+template <class T> struct Part2Search {
+	ReducedSystem<T> sys;
+	vector<long long> bounds;
+	atomic<long long> best{ -1 };
+	atomic<bool> ok{ true }; // cleared when an intermediate overflows T
+	WorkStealingPool* pool = nullptr; // set to hand subtrees to idle workers
+
+	vector<T> free_cols; // free_cols[k * pivots + i]: row i, free var k
+	vector<T> future_min; // future_min[k * pivots + i]: over free vars >= k
+	vector<T> future_max;
+	vector<T> pivot_cap; // den * bound of each pivot row's variable
+
+	int pivots() const { return sys.pivot_vars.size(); }
+	const T* free_col(size_t k) const { return &free_cols[k * pivots()]; }
+};
+
+// The assignment along one search path, with the residual rhs - sum(coeff_f
+// * x_f) over the free variables assigned so far, per pivot row.
+template <class T> struct SearchPath {
+	vector<long long> solution;
+	vector<T> residual;
+};
+
+template <class T> void prepare_search(Part2Search<T>& search) {
+	const ReducedSystem<T>& sys = search.sys;
+	int p = sys.pivot_vars.size();
+	size_t f = sys.free_vars.size();
+	bool ok = true;
+	search.free_cols.resize(f * p);
+	search.future_min.assign((f + 1) * p, 0);
+	search.future_max.assign((f + 1) * p, 0);
+	search.pivot_cap.resize(p);
+	for (int i = 0; i < p; ++i) {
+		search.pivot_cap[i] = mul_checked(sys.den[i],
+			(T)search.bounds[sys.pivot_vars[i]], ok);
+	}
+	for (size_t k = f; k-- > 0;) {
+		int var = sys.free_vars[k];
+		for (int i = 0; i < p; ++i) {
+			T fc = sys.row(i)[var];
+			T term = mul_checked(fc, (T)search.bounds[var], ok);
+			search.free_cols[k * p + i] = fc;
+			search.future_min[k * p + i] = search.future_min[(k + 1) * p + i];
+			search.future_max[k * p + i] = search.future_max[(k + 1) * p + i];
+			if (fc < 0)
+				search.future_min[k * p + i] =
+				add_checked(search.future_min[k * p + i], term, ok);
+			else
+				search.future_max[k * p + i] =
+				add_checked(search.future_max[k * p + i], term, ok);
 		}
-		// Reset basic vars for next iteration (not strictly needed if overwritten,
-		// but good practice)
-		for (int p_idx : pivot_vars)
-			current_solution[p_idx] = 0;
+	}
+	if (!ok)
+		search.ok = false;
+}
+
+template <class T>
+void search_free_values(Part2Search<T>& search, SearchPath<T>& path,
+	size_t free_var_idx, long long current_cost, long long lower,
+	long long upper);
+
+template <class T>
+void solve_system_recursive(Part2Search<T>& search, SearchPath<T>& path,
+	size_t free_var_idx, long long current_cost) {
+	const ReducedSystem<T>& sys = search.sys;
+	const vector<long long>& global_bounds = search.bounds;
+	const vector<int>& free_vars = sys.free_vars;
+	const vector<int>& pivot_vars = sys.pivot_vars;
+	const vector<T>& residual = path.residual;
+	int p = pivot_vars.size();
+	if (!search.ok.load(memory_order_relaxed))
+		return;
+
+	long long best = search.best.load(memory_order_relaxed);
+	if (best != -1 && current_cost >= best)
+		return;
+
+	if (free_var_idx == free_vars.size()) {
+		// Calculate basic vars: den * x_pivot = residual
+		long long temp_cost = current_cost;
+
+		for (int i = 0; i < p; ++i) {
+			if (residual[i] % sys.den[i] != 0)
+				return;
+			T int_val = residual[i] / sys.den[i];
+			if (int_val < 0 || int_val > global_bounds[pivot_vars[i]])
+				return; // Check global upper bound
+			temp_cost += (long long)int_val;
+		}
+
+		update_min(search.best, temp_cost);
 		return;
 	}
 
@@ -239,100 +910,46 @@ void solve_system_recursive(const vector<vector<Fraction>>& reduced_matrix,
 	// 1. Global Bound
 	long long g_bound = global_bounds[current_free_var_idx];
 
-	long long lower_bound = 0;
-	long long upper_bound = g_bound;
+	T lower_bound = 0;
+	T upper_bound = g_bound;
 
-	// 2. Constraints from basic vars
-	// X_pivot = RHS' - Coeff * X_f - Sum(Coeff_future * X_future)
+	// 2. Constraints from basic vars, scaled by the row's den:
+	// den * X_pivot = residual - coeff * X_f - Sum(coeff_future * X_future)
 	// We require 0 <= X_pivot <= Global_Bound_Pivot
 
-	for (size_t i = 0; i < pivot_vars.size(); ++i) {
-		Fraction coeff = reduced_matrix[i][current_free_var_idx];
-		if (coeff.num == 0)
+	const T* col = search.free_col(free_var_idx);
+	const T* future_min = &search.future_min[(free_var_idx + 1) * p];
+	const T* future_max = &search.future_max[(free_var_idx + 1) * p];
+	bool ok = true;
+	for (int i = 0; i < p; ++i) {
+		T coeff = col[i];
+		if (coeff == 0)
 			continue; // This free var doesn't affect this pivot var
 
-		Fraction rhs_rem = reduced_matrix[i].back();
-		for (size_t f = 0; f < free_var_idx; ++f) {
-			rhs_rem = rhs_rem - (reduced_matrix[i][free_vars[f]] *
-				Fraction(current_solution[free_vars[f]]));
-		}
-
-		// Constraint 1: X_pivot >= 0
-		// X_pivot = rhs_rem - coeff * X_f - Sum_future_terms >= 0
-		// coeff * X_f <= rhs_rem - Sum_future_terms
-		// To get the tightest upper bound for X_f, we need to maximize (rhs_rem -
-		// Sum_future_terms). This means minimizing Sum_future_terms.
-		// Sum_future_terms = sum(reduced_matrix[i][free_vars[k]] * X_k) for k >
-		// free_var_idx Min Sum_future_terms occurs when X_k = 0 for positive
-		// coeffs, and X_k = global_bounds[X_k] for negative coeffs.
-
-		Fraction future_min_sum(0);
-		for (size_t k = free_var_idx + 1; k < free_vars.size(); ++k) {
-			Fraction fc = reduced_matrix[i][free_vars[k]];
-			if (fc < Fraction(0)) { // If coefficient is negative, X_k should be max
-				// to minimize the sum
-				future_min_sum =
-					future_min_sum + (fc * Fraction(global_bounds[free_vars[k]]));
-			}
-		}
-
-		Fraction max_rhs_for_xf = rhs_rem - future_min_sum;
-
-		if (coeff > Fraction(0)) {
-			// X_f <= max_rhs_for_xf / coeff
-			if (max_rhs_for_xf < Fraction(0)) { // If RHS is negative, X_f must be
-				// negative, which is impossible
-				upper_bound = -1;                 // Force break
-			}
-			else {
-				Fraction lim = max_rhs_for_xf / coeff;
-				long long l = lim.to_long(); // Truncate for upper bound
-				if (l < upper_bound)
-					upper_bound = l;
-			}
+		// Constraint 1: X_pivot >= 0, i.e.
+		// coeff * X_f <= residual - Sum_future_terms, loosest with the future
+		// terms at their minimum.
+		// Constraint 2: X_pivot <= GlobalPivotBound, i.e.
+		// coeff * X_f >= residual - Sum_future_terms - den * GlobalPivotBound,
+		// loosest with the future terms at their maximum.
+		T max_rhs_for_xf = sub_checked(residual[i], future_min[i], ok);
+		T min_rhs_for_xf = sub_checked(sub_checked(residual[i], future_max[i], ok),
+			search.pivot_cap[i], ok);
+		if (!ok) {
+			search.ok = false;
+			return;
 		}
-		else { // coeff < Fraction(0)
-			// X_f >= max_rhs_for_xf / coeff (inequality flips)
-			Fraction lim = max_rhs_for_xf / coeff;
-			long long l = (long long)ceil(lim.to_double()); // Ceil for lower bound
-			if (l > lower_bound)
-				lower_bound = l;
-		}
-
-		// Constraint 2: X_pivot <= GlobalPivotBound
-		// rhs_rem - coeff * X_f - Sum_future_terms <= GlobalPivotBound
-		// coeff * X_f >= rhs_rem - Sum_future_terms - GlobalPivotBound
-		// To get the tightest lower bound for X_f, we need to minimize (rhs_rem -
-		// Sum_future_terms - GlobalPivotBound). This means maximizing
-		// Sum_future_terms. Max Sum_future_terms occurs when X_k =
-		// global_bounds[X_k] for positive coeffs, and X_k = 0 for negative coeffs.
-
-		Fraction future_max_sum(0);
-		for (size_t k = free_var_idx + 1; k < free_vars.size(); ++k) {
-			Fraction fc = reduced_matrix[i][free_vars[k]];
-			if (fc > Fraction(0)) { // If coefficient is positive, X_k should be max
-				// to maximize the sum
-				future_max_sum =
-					future_max_sum + (fc * Fraction(global_bounds[free_vars[k]]));
-			}
-		}
-
-		Fraction min_rhs_for_xf =
-			rhs_rem - future_max_sum - Fraction(global_bounds[pivot_vars[i]]);
 
-		if (coeff > Fraction(0)) {
-			// X_f >= min_rhs_for_xf / coeff
-			Fraction lim = min_rhs_for_xf / coeff;
-			long long l = (long long)ceil(lim.to_double()); // Ceil for lower bound
-			if (l > lower_bound)
-				lower_bound = l;
+		if (coeff > 0) {
+			if (max_rhs_for_xf < 0)
+				upper_bound = -1; // X_f would have to be negative
+			else
+				upper_bound = min(upper_bound, floor_div(max_rhs_for_xf, coeff));
+			lower_bound = max(lower_bound, ceil_div(min_rhs_for_xf, coeff));
 		}
-		else { // Coeff < Fraction(0)
-			// X_f <= min_rhs_for_xf / coeff (inequality flips)
-			Fraction lim = min_rhs_for_xf / coeff;
-			long long l = (long long)floor(lim.to_double()); // Floor for upper bound
-			if (l < upper_bound)
-				upper_bound = l;
+		else {
+			lower_bound = max(lower_bound, ceil_div(max_rhs_for_xf, coeff));
+			upper_bound = min(upper_bound, floor_div(min_rhs_for_xf, coeff));
 		}
 	}
 
@@ -344,29 +961,99 @@ void solve_system_recursive(const vector<vector<Fraction>>& reduced_matrix,
 	if (upper_bound < lower_bound)
 		return; // Impossible range
 
-	for (long long val = lower_bound; val <= upper_bound; ++val) {
-		current_solution[current_free_var_idx] = val;
+	search_free_values(search, path, free_var_idx, current_cost,
+		(long long)lower_bound, (long long)upper_bound);
+}
 
+// residual -= col * times, for the p pivot rows.
+template <class T>
+void subtract_column(vector<T>& residual, const T* col, T times, bool& ok) {
+	for (size_t i = 0; i < residual.size(); ++i) {
+		if (col[i] != 0)
+			residual[i] = sub_checked(residual[i], mul_checked(col[i], times, ok), ok);
+	}
+}
+
+// Tries the values lower..upper of free variable free_var_idx, moving the
+// residual by one column per step. While the pool is hungry the upper half
+// of the remaining range is handed off as a task of its own, so a straggling
+// machine spreads over the idle workers.
+template <class T>
+void search_free_values(Part2Search<T>& search, SearchPath<T>& path,
+	size_t free_var_idx, long long current_cost, long long lower,
+	long long upper) {
+	int current_free_var_idx = search.sys.free_vars[free_var_idx];
+	const T* col = search.free_col(free_var_idx);
+	bool ok = true;
+	long long applied = 0; // value of X_f included in the residual
+	for (long long val = lower; val <= upper; ++val) {
 		// Pruning: If current partial cost already exceeds or equals
-		// min_total_presses, no need to continue down this path
-		if (min_total_presses != -1 && (current_cost + val) >= min_total_presses) {
+		// the best total, no need to continue down this path
+		long long best = search.best.load(memory_order_relaxed);
+		if (best != -1 && (current_cost + val) >= best) {
 			// Since we iterate from lower_bound upwards, and cost increases, we can
-			// break. No need to reset current_solution[current_free_var_idx] here, as
-			// it will be reset after the loop.
+			// break.
 			break;
 		}
+		if (!search.ok.load(memory_order_relaxed))
+			break;
 
-		solve_system_recursive(reduced_matrix, free_vars, pivot_vars, global_bounds,
-			current_solution, free_var_idx + 1);
+		if (search.pool && val < upper && search.pool->hungry()) {
+			long long split = val + (upper - val) / 2;
+			SearchPath<T> half = path;
+			subtract_column(half.residual, col, (T)-applied, ok);
+			search.pool->spawn([&search, half, free_var_idx, current_cost, split,
+				upper]() mutable {
+				search_free_values(search, half, free_var_idx, current_cost,
+					split + 1, upper);
+			});
+			upper = split;
+		}
+
+		subtract_column(path.residual, col, (T)(val - applied), ok);
+		applied = val;
+		if (!ok) {
+			search.ok = false;
+			break;
+		}
+		path.solution[current_free_var_idx] = val;
+		solve_system_recursive(search, path, free_var_idx + 1,
+			current_cost + val);
 	}
-	current_solution[current_free_var_idx] = 0; // Reset for backtracking
+	subtract_column(path.residual, col, (T)-applied, ok); // Reset for backtracking
+	path.solution[current_free_var_idx] = 0;
 }
 
-long long solve_part2(const Machine& m) {
-	min_total_presses = -1;
+// Runs the search of a machine whose system is already reduced.
+template <class T> void start_search(Part2Search<T>& search) {
+	if (!search.ok || !search.sys.consistent)
+		return;
+	prepare_search(search);
+	SearchPath<T> path;
+	path.solution.assign(search.bounds.size(), 0);
+	for (int i = 0; i < search.pivots(); ++i)
+		path.residual.push_back(search.sys.rhs(i));
+	solve_system_recursive(search, path, 0, 0);
+}
+
+// One machine in integer type T; clears ok on overflow.
+template <class T>
+long long solve_part2_with(const Machine& m, const vector<long long>& bounds,
+	bool& ok) {
+	Part2Search<T> search;
+	search.sys = reduce_system<T>(m, ok);
+	search.bounds = bounds;
+	search.ok = ok;
+	start_search(search);
+	ok = search.ok;
+	return search.best;
+}
+
+atomic<long long> part2_wide_machines{ 0 }; // machines that needed __int128
 
+// Upper bound on each button's press count.
+vector<long long> press_bounds(const Machine& m) {
 	int num_vars = m.buttons.size();
-	int num_eqs = m.joltage_requirements.size();
 
 	// Calculate Global Bounds for each variable (button press count)
 	// A button press adds 1 to certain joltage requirements.
@@ -399,87 +1086,445 @@ long long solve_part2(const Machine& m) {
 		}
 	}
 
-	vector<vector<Fraction>> matrix(num_eqs, vector<Fraction>(num_vars + 1));
+	return global_bounds;
+}
 
-	for (int j = 0; j < num_vars; ++j) {
-		for (int row_idx : m.buttons[j]) {
-			if (row_idx < num_eqs) {
-				matrix[row_idx][j] = Fraction(1);
+// Redoes in __int128 a machine whose long long search overflowed.
+long long solve_part2_wide(const Machine& m) {
+	part2_wide_machines++;
+	bool ok = true;
+	long long result = solve_part2_with<__int128>(m, press_bounds(m), ok);
+	if (!ok) {
+		cerr << "Machine overflows 128-bit arithmetic." << endl;
+		return -1;
+	}
+	return result;
+}
+
+long long solve_part2(const Machine& m) {
+	bool ok = true;
+	long long result = solve_part2_with<long long>(m, press_bounds(m), ok);
+	return ok ? result : solve_part2_wide(m);
+}
+
+// Part 2 as an integer program: minimise sum(x) subject to A x = b and
+// 0 <= x <= press_bounds, by branch and bound over LP relaxations. The LP is
+// solved by a bounded dual simplex on a dense tableau. One artificial
+// variable fixed at zero per row gives an initial basis that is dual
+// feasible (all costs are 1), so the dual simplex only has to restore primal
+// feasibility. A child node changes one bound of a basic variable, which
+// keeps the parent's final basis dual feasible: it starts from that tableau
+// and usually needs a few pivots.
+enum LpStatus { LP_OPTIMAL, LP_INFEASIBLE, LP_GAVE_UP };
+
+struct BoundedDualSimplex {
+	int m = 0, n = 0; // rows, columns (structural then artificial)
+	vector<double> tab; // m x (n + 1), B^-1 [A | b]
+	vector<double> cost; // reduced costs
+	vector<double> lo, hi; // current bounds
+	vector<int> basis; // basic column per row
+	vector<bool> at_upper; // nonbasic columns sitting at hi
+	vector<double> value; // current value of every column
+	double objective = 0;
+
+	static constexpr double EPS = 1e-9;
+
+	double& at(int r, int c) { return tab[(size_t)r * (n + 1) + c]; }
+
+	BoundedDualSimplex(const Machine& mach, const vector<long long>& bounds) {
+		int vars = mach.buttons.size();
+		m = mach.joltage_requirements.size();
+		n = vars + m;
+		tab.assign((size_t)m * (n + 1), 0.0);
+		for (int j = 0; j < vars; ++j) {
+			for (int row : mach.buttons[j]) {
+				if (row < m)
+					at(row, j) = 1.0;
 			}
 		}
+		for (int r = 0; r < m; ++r) {
+			at(r, vars + r) = 1.0;
+			at(r, n) = mach.joltage_requirements[r];
+		}
+		cost.assign(n, 0.0);
+		lo.assign(n, 0.0);
+		hi.assign(n, 0.0); // artificials are fixed at 0
+		for (int j = 0; j < vars; ++j) {
+			cost[j] = 1.0;
+			hi[j] = bounds[j];
+		}
+		basis.resize(m);
+		for (int r = 0; r < m; ++r)
+			basis[r] = vars + r;
+		at_upper.assign(n, false);
+		value.assign(n, 0.0);
 	}
-	for (int i = 0; i < num_eqs; ++i) {
-		matrix[i][num_vars] = Fraction(m.joltage_requirements[i]);
+
+	// Values of the basic variables from the nonbasic ones.
+	void refresh() {
+		vector<bool> is_basic(n, false);
+		for (int b : basis)
+			is_basic[b] = true;
+		objective = 0;
+		for (int j = 0; j < n; ++j) {
+			if (!is_basic[j])
+				value[j] = at_upper[j] ? hi[j] : lo[j];
+		}
+		for (int r = 0; r < m; ++r) {
+			double v = at(r, n);
+			for (int j = 0; j < n; ++j) {
+				if (!is_basic[j] && value[j] != 0.0)
+					v -= at(r, j) * value[j];
+			}
+			value[basis[r]] = v;
+		}
+		for (int j = 0; j < n; ++j) {
+			if (j < n - m)
+				objective += value[j];
+		}
 	}
 
-	int pivot_row = 0;
-	vector<int> pivot_cols;
+	void pivot(int r, int q) {
+		double p = at(r, q);
+		for (int c = 0; c <= n; ++c)
+			at(r, c) /= p;
+		for (int i = 0; i < m; ++i) {
+			if (i == r)
+				continue;
+			double f = at(i, q);
+			if (f == 0.0)
+				continue;
+			for (int c = 0; c <= n; ++c)
+				at(i, c) -= f * at(r, c);
+		}
+		double f = cost[q];
+		if (f != 0.0) {
+			for (int c = 0; c < n; ++c)
+				cost[c] -= f * at(r, c);
+		}
+		basis[r] = q;
+	}
 
-	for (int col = 0; col < num_vars && pivot_row < num_eqs; ++col) {
-		int sel = -1;
-		for (int row = pivot_row; row < num_eqs; ++row) {
-			if (matrix[row][col].num != 0) {
-				sel = row;
-				break;
+	// Dual simplex to optimality. The leaving row is the one with the largest
+	// violation until DEGENERATE_RUN pivots in a row have not moved the
+	// objective; from then on it is the violated basic variable of smallest
+	// index, which with the entering tie-break below is Bland's rule and
+	// cannot cycle. Gives up after max_pivots all the same.
+	LpStatus solve() {
+		const int DEGENERATE_RUN = 50;
+		const int max_pivots = 50 * (m + n) + 1000;
+		int degenerate = 0;
+		bool bland = false;
+		for (int pivots = 0;; ++pivots) {
+			refresh();
+			int r = -1;
+			double worst = 1e-7;
+			for (int i = 0; i < m; ++i) {
+				double v = value[basis[i]];
+				double viol = max(lo[basis[i]] - v, v - hi[basis[i]]);
+				if (viol <= 1e-7)
+					continue;
+				if (bland ? (r == -1 || basis[i] < basis[r]) : viol > worst) {
+					worst = viol;
+					r = i;
+				}
 			}
+			if (r == -1)
+				return LP_OPTIMAL;
+			if (pivots == max_pivots)
+				return LP_GAVE_UP;
+
+			int leaving = basis[r];
+			bool below = value[leaving] < lo[leaving];
+			vector<bool> is_basic(n, false);
+			for (int b : basis)
+				is_basic[b] = true;
+
+			// Entering column: the one that keeps the reduced costs dual
+			// feasible, smallest |d_j / alpha_rj| among the columns that can
+			// move x_leaving towards its violated bound, ties to the lowest
+			// index.
+			int q = -1;
+			double best_ratio = 0;
+			for (int j = 0; j < n; ++j) {
+				if (is_basic[j] || hi[j] - lo[j] < EPS)
+					continue;
+				double alpha = at(r, j);
+				if (fabs(alpha) < EPS)
+					continue;
+				bool helps = below ? ((alpha < 0) != at_upper[j])
+					: ((alpha > 0) != at_upper[j]);
+				if (!helps)
+					continue;
+				double ratio = fabs(cost[j] / alpha);
+				if (q == -1 || ratio < best_ratio - EPS) {
+					q = j;
+					best_ratio = ratio;
+				}
+			}
+			if (q == -1)
+				return LP_INFEASIBLE;
+
+			degenerate = best_ratio < EPS ? degenerate + 1 : 0;
+			if (degenerate >= DEGENERATE_RUN)
+				bland = true;
+			pivot(r, q);
+			at_upper[leaving] = !below;
+			at_upper[q] = false;
 		}
+	}
 
-		if (sel == -1)
-			continue;
+	void set_bounds(int j, double new_lo, double new_hi) {
+		lo[j] = new_lo;
+		hi[j] = new_hi;
+	}
+};
 
-		swap(matrix[pivot_row], matrix[sel]);
+// Depth-first branch and bound. best is the incumbent total (-1 for none);
+// gave_up is set, and the search abandoned, if an LP hits its pivot limit.
+void branch_and_bound(BoundedDualSimplex lp, const Machine& mach,
+	long long& best, bool& gave_up) {
+	if (gave_up)
+		return;
+	LpStatus status = lp.solve();
+	if (status == LP_GAVE_UP)
+		gave_up = true;
+	if (status != LP_OPTIMAL)
+		return;
+	long long bound = (long long)ceil(lp.objective - 1e-6);
+	if (best != -1 && bound >= best)
+		return;
 
-		Fraction p_val = matrix[pivot_row][col];
-		for (int j = col; j <= num_vars; ++j) {
-			matrix[pivot_row][j] = matrix[pivot_row][j] / p_val;
+	int vars = mach.buttons.size();
+	int branch = -1;
+	double most = 1e-6;
+	for (int j = 0; j < vars; ++j) {
+		double frac = fabs(lp.value[j] - floor(lp.value[j] + 0.5));
+		if (frac > most) {
+			most = frac;
+			branch = j;
 		}
+	}
 
-		for (int i = 0; i < num_eqs; ++i) {
-			if (i != pivot_row) {
-				Fraction factor = matrix[i][col];
-				for (int j = col; j <= num_vars; ++j) {
-					matrix[i][j] = matrix[i][j] - (factor * matrix[pivot_row][j]);
-				}
+	if (branch == -1) {
+		// Integral up to rounding; confirm exactly before accepting it.
+		vector<long long> x(vars);
+		long long total = 0;
+		for (int j = 0; j < vars; ++j) {
+			x[j] = llround(lp.value[j]);
+			total += x[j];
+		}
+		vector<long long> sums(mach.joltage_requirements.size(), 0);
+		for (int j = 0; j < vars; ++j) {
+			for (int row : mach.buttons[j]) {
+				if (row < (int)sums.size())
+					sums[row] += x[j];
 			}
 		}
+		if (sums == mach.joltage_requirements) {
+			if (best == -1 || total < best)
+				best = total;
+			return;
+		}
 
-		pivot_cols.push_back(col);
-		pivot_row++;
+		// Rounding hid a violation. Split a variable that is not yet fixed
+		// three ways around its rounded value, so every child fixes it or
+		// shrinks its range; with every variable fixed the point above was
+		// the only candidate.
+		int split = -1;
+		for (int j = 0; j < vars && split == -1; ++j) {
+			if (lp.lo[j] < lp.hi[j])
+				split = j;
+		}
+		if (split == -1)
+			return;
+		double r = (double)x[split];
+		const double ranges[3][2] = { { lp.lo[split], r - 1 }, { r, r },
+			{ r + 1, lp.hi[split] } };
+		for (const auto& range : ranges) {
+			if (range[0] > range[1])
+				continue;
+			BoundedDualSimplex child = lp;
+			child.set_bounds(split, range[0], range[1]);
+			branch_and_bound(child, mach, best, gave_up);
+		}
+		return;
 	}
 
-	for (int i = pivot_row; i < num_eqs; ++i) {
-		if (matrix[i][num_vars].num != 0) {
-			return -1; // Inconsistent system
-		}
+	// Round-down child first when the value is closer to its floor.
+	double v = lp.value[branch];
+	double down_hi = floor(v), up_lo = ceil(v);
+	bool down_first = v - down_hi < 0.5;
+	for (int side = 0; side < 2; ++side) {
+		bool down = (side == 0) == down_first;
+		BoundedDualSimplex child = lp;
+		if (down)
+			child.set_bounds(branch, lp.lo[branch], down_hi);
+		else
+			child.set_bounds(branch, up_lo, lp.hi[branch]);
+		branch_and_bound(child, mach, best, gave_up);
 	}
+}
 
-	vector<int> free_vars;
-	vector<bool> is_pivot(num_vars, false);
-	for (int col : pivot_cols)
-		is_pivot[col] = true;
-	for (int j = 0; j < num_vars; ++j) {
-		if (!is_pivot[j])
-			free_vars.push_back(j);
+// The LP and the exact check both work on the canonical machine, where a
+// counter listed twice on one button counts once, as in the elimination. A
+// machine whose LPs give up is handed to the exact search.
+long long solve_part2_ilp(const Machine& m) {
+	Machine c = canonical_machine(m);
+	BoundedDualSimplex lp(c, press_bounds(c));
+	long long best = -1;
+	bool gave_up = false;
+	branch_and_bound(lp, c, best, gave_up);
+	return gave_up ? solve_part2(m) : best;
+}
+
+// Random machine in the puzzle's shape: each button toggles a few lights,
+// and the target is reachable by construction.
+Machine random_machine(mt19937& rng, int num_lights, int num_buttons) {
+	Machine m;
+	m.target_pattern.assign(num_lights, 0);
+	uniform_int_distribution<int> light(0, num_lights - 1);
+	for (int j = 0; j < num_buttons; ++j) {
+		int count = 1 + rng() % min(num_lights, 5);
+		vector<int> idx;
+		while ((int)idx.size() < count) {
+			int i = light(rng);
+			if (find(idx.begin(), idx.end(), i) == idx.end())
+				idx.push_back(i);
+		}
+		sort(idx.begin(), idx.end());
+		m.buttons.push_back(idx);
+		if (rng() % 3 == 0) {
+			for (int i : idx)
+				m.target_pattern[i] ^= 1;
+		}
 	}
+	return m;
+}
 
-	matrix.resize(pivot_row); // Only keep the non-zero rows
+void bench_part1() {
+	// The recursion is 2^buttons, so it only runs on the smaller sizes.
+	const int RECURSIVE_LIMIT = 24;
+	mt19937 rng(12345);
+	for (int num_lights : { 10, 32 }) {
+		for (int num_buttons : { 8, 16, 20, 24, 32, 48, 64 }) {
+			const int machines = 20;
+			vector<Machine> ms;
+			for (int k = 0; k < machines; ++k)
+				ms.push_back(random_machine(rng, num_lights, num_buttons));
+
+			auto t0 = chrono::steady_clock::now();
+			long long gf2_total = 0;
+			for (const Machine& m : ms)
+				gf2_total += solve_part1_gf2(m);
+			auto t1 = chrono::steady_clock::now();
+			cout << num_lights << " lights, " << num_buttons << " buttons: gf2 "
+				<< chrono::duration<double, milli>(t1 - t0).count() / machines
+				<< " ms/machine";
+			if (num_buttons <= RECURSIVE_LIMIT) {
+				long long rec_total = 0;
+				for (const Machine& m : ms)
+					rec_total += solve_part1(m);
+				auto t2 = chrono::steady_clock::now();
+				cout << ", recursive "
+					<< chrono::duration<double, milli>(t2 - t1).count() / machines
+					<< " ms/machine"
+					<< (rec_total == gf2_total ? "" : " MISMATCH");
+			}
+			cout << endl;
+		}
+	}
+}
 
-	vector<long long> current_solution(num_vars, 0);
-	solve_system_recursive(matrix, free_vars, pivot_cols, global_bounds,
-		current_solution, 0);
+// Part 2 on ordinary machines: the same search in unchecked long long,
+// checked long long (the default path) and __int128, to measure what the
+// overflow checks and the wide fallback cost.
+void bench_part2() {
+	mt19937 rng(54321);
+	for (int num_lights : { 6, 10 }) {
+		const int machines = 200;
+		vector<Machine> ms;
+		for (int k = 0; k < machines; ++k) {
+			Machine m = random_machine(rng, num_lights, num_lights + 2);
+			m.joltage_requirements.assign(num_lights, 0);
+			for (const vector<int>& b : m.buttons) {
+				long long presses = rng() % 40;
+				for (int i : b)
+					m.joltage_requirements[i] += presses;
+			}
+			ms.push_back(m);
+		}
 
-	return min_total_presses;
+		auto t0 = chrono::steady_clock::now();
+		long long unchecked_total = 0;
+		for (const Machine& m : ms) {
+			bool ok = true;
+			unchecked_total += solve_part2_with<Unchecked>(m, press_bounds(m), ok);
+		}
+		auto t1 = chrono::steady_clock::now();
+		long long narrow_total = 0;
+		for (const Machine& m : ms)
+			narrow_total += solve_part2(m);
+		auto t2 = chrono::steady_clock::now();
+		long long wide_total = 0;
+		for (const Machine& m : ms) {
+			bool ok = true;
+			wide_total += solve_part2_with<__int128>(m, press_bounds(m), ok);
+		}
+		auto t3 = chrono::steady_clock::now();
+		cout << num_lights << " counters: unchecked 64-bit "
+			<< chrono::duration<double, micro>(t1 - t0).count() / machines
+			<< " us/machine, checked 64-bit "
+			<< chrono::duration<double, micro>(t2 - t1).count() / machines
+			<< " us/machine, 128-bit "
+			<< chrono::duration<double, micro>(t3 - t2).count() / machines
+			<< " us/machine"
+			<< (unchecked_total == narrow_total && narrow_total == wide_total
+				? "" : " MISMATCH") << endl;
+	}
+	cout << "Machines promoted to 128-bit: " << part2_wide_machines << endl;
 }
 
 int main(int argc, char* argv[]) {
 	string filename = "input.txt";
-	if (argc > 1) {
-		filename = argv[1];
+	bool has_file = false;
+	bool recursive = false;
+	bool ilp = false;
+	int num_threads = max(1u, thread::hardware_concurrency());
+	string cache_file;
+	bool show_stats = false;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--recursive") {
+			recursive = true;
+		}
+		else if (arg == "--ilp") {
+			ilp = true;
+		}
+		else if (arg == "--bench") {
+			bench_part1();
+			bench_part2();
+			return 0;
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			num_threads = max(1, stoi(argv[++i]));
+		}
+		else if (arg == "--cache" && i + 1 < argc) {
+			cache_file = argv[++i];
+		}
+		else if (arg == "--stats") {
+			show_stats = true;
+		}
+		else {
+			filename = arg;
+			has_file = true;
+		}
 	}
 
 	ifstream infile(filename);
 	istream* input = &cin;
-	if (filename != "input.txt" || argc > 1) {
+	if (has_file) {
 		if (!infile) {
 			cerr << "Error opening file: " << filename << endl;
 			return 1;
@@ -502,28 +1547,95 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
-	long long total_presses = 0;
+	vector<Machine> machines;
 	for (const string& l : lines) {
-		if (l.empty())
-			continue;
-		Machine m = parse_machine(l);
-		long long presses = -1;
+		if (!l.empty())
+			machines.push_back(parse_machine(l));
+	}
+	size_t n = machines.size();
+
+	// Machines are spread over a work-stealing pool, the most expensive first.
+	// For part 2 the cost estimate is the number of free variables left after
+	// elimination, as the search is exponential in it.
+	vector<long long> presses(n, -1);
+	vector<int> cost(n, 0);
+	vector<WorkStealingPool::Task> tasks(n);
+	vector<Part2Search<long long>> searches(part == 2 && !ilp ? n : 0);
+	WorkStealingPool pool(num_threads);
+	// Part 2 machines with the same wiring share one elimination, optionally
+	// kept on disk between runs.
+	EliminationCache cache;
+	if (!cache_file.empty() && !cache.load(cache_file))
+		cerr << "Ignoring unreadable cache: " << cache_file << endl;
+	for (size_t i = 0; i < n; ++i) {
+		const Machine& m = machines[i];
 		if (part == 1) {
-			presses = solve_part1(m);
+			cost[i] = m.buttons.size();
+			tasks[i] = [&, i]() {
+				if (recursive || (int)machines[i].buttons.size() > GF2_MAX_BUTTONS)
+					presses[i] = solve_part1(machines[i]);
+				else
+					presses[i] = solve_part1_gf2(machines[i]);
+			};
+		}
+		else if (part == 2 && ilp) {
+			const Elimination<long long>* e = cache.get(canonical_machine(m));
+			cost[i] = e ? e->free_vars.size() : m.buttons.size();
+			tasks[i] = [&, i]() { presses[i] = solve_part2_ilp(machines[i]); };
 		}
 		else if (part == 2) {
-			presses = solve_part2(m);
+			Part2Search<long long>& search = searches[i];
+			Machine c = canonical_machine(m);
+			const Elimination<long long>* e = cache.get(c);
+			bool ok = e != nullptr;
+			if (ok)
+				search.sys = apply_elimination(*e, c, ok);
+			search.bounds = press_bounds(c);
+			search.ok = ok;
+			search.pool = &pool;
+			cost[i] = search.sys.free_vars.size();
+			tasks[i] = [&search]() { start_search(search); };
 		}
+	}
 
-		if (presses != -1) {
-			total_presses += presses;
-		}
-		else {
-			// Safe to ignore for valid puzzles usually
-		}
+	vector<size_t> order(n);
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(),
+		[&](size_t x, size_t y) { return cost[x] > cost[y]; });
+	vector<WorkStealingPool::Task> ordered;
+	for (size_t i : order)
+		ordered.push_back(move(tasks[i]));
+	pool.schedule(move(ordered));
+	pool.run();
+
+	for (size_t i = 0; i < searches.size(); ++i) {
+		// Machines that overflowed long long are redone one by one.
+		presses[i] = searches[i].ok ? searches[i].best.load()
+			: solve_part2_wide(machines[i]);
 	}
 
-	cout << total_presses << endl;
+	// A total that leaves out a machine, or has wrapped, is not printed.
+	long long total_presses = 0;
+	bool solved = true, fits = true;
+	for (size_t i = 0; i < n; ++i) {
+		if (presses[i] == -1) {
+			cerr << "Machine " << i + 1 << " could not be solved." << endl;
+			solved = false;
+		}
+		else
+			total_presses = add_checked(total_presses, presses[i], fits);
+	}
+	if (!fits)
+		cerr << "Total presses overflow 64 bits." << endl;
+	if (solved && fits)
+		cout << total_presses << endl;
+	if (!cache_file.empty() && !cache.save(cache_file))
+		cerr << "Error writing cache: " << cache_file << endl;
+	if (show_stats) {
+		cout << "Elimination cache: " << cache.hits << " hits, " << cache.misses
+			<< " misses" << endl;
+		cout << "Machines solved in 128-bit: " << part2_wide_machines << endl;
+	}
 
-	return 0;
+	return solved && fits ? 0 : 1;
 }
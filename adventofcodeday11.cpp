@@ -1,58 +1,293 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <map>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
 using namespace std;
 
-map<string, vector<string>> adj;
-map<pair<string, string>, long long> memo_map;
+// Devices are interned to dense ids in order of first appearance. Edges are
+// kept in compressed sparse row form both ways: the outputs of node u are
+// out_targets[out_offsets[u]..out_offsets[u + 1]), and its inputs likewise
+// in in_sources.
+struct Graph {
+	unordered_map<string, int> ids;
+	vector<string> names;
+	vector<int> out_offsets, out_targets;
+	vector<int> in_offsets, in_sources;
 
-long long count_paths(string u, string target) {
-	if (u == target)
-		return 1;
-	if (memo_map.count({ u, target }))
-		return memo_map[{u, target}];
+	int size() const { return names.size(); }
 
-	long long paths = 0;
-	if (adj.count(u)) {
-		for (const string& v : adj[u]) {
-			paths += count_paths(v, target);
+	int intern(const string& name) {
+		auto [it, inserted] = ids.emplace(name, (int)names.size());
+		if (inserted)
+			names.push_back(name);
+		return it->second;
+	}
+
+	// -1 for a device the input never mentions.
+	int id(const string& name) const {
+		auto it = ids.find(name);
+		return it == ids.end() ? -1 : it->second;
+	}
+
+	// Builds both CSR arrays from an edge list by counting sort.
+	void build(const vector<pair<int, int>>& edges) {
+		int n = size();
+		out_offsets.assign(n + 1, 0);
+		in_offsets.assign(n + 1, 0);
+		for (const auto& [u, v] : edges) {
+			out_offsets[u + 1]++;
+			in_offsets[v + 1]++;
+		}
+		for (int u = 0; u < n; ++u) {
+			out_offsets[u + 1] += out_offsets[u];
+			in_offsets[u + 1] += in_offsets[u];
+		}
+		out_targets.resize(edges.size());
+		in_sources.resize(edges.size());
+		vector<int> out_pos(out_offsets.begin(), out_offsets.end() - 1);
+		vector<int> in_pos(in_offsets.begin(), in_offsets.end() - 1);
+		for (const auto& [u, v] : edges) {
+			out_targets[out_pos[u]++] = v;
+			in_sources[in_pos[v]++] = u;
+		}
+	}
+};
+
+// Number of paths from every node to target. A path stops at target, so
+// target's own outputs are never followed.
+//
+// Only nodes that can reach target matter. Among them, counts are filled in
+// reverse topological order: a node is done once all of its outputs that
+// reach target are, which Kahn's algorithm over the input lists gives
+// without recursion. Nodes left over sit on or upstream of a cycle that
+// reaches target, so they have infinitely many paths and are marked
+// unbounded instead.
+struct PathCounts {
+	vector<long long> count;
+	vector<char> unbounded;
+};
+
+PathCounts count_paths_to(const Graph& g, int target) {
+	int n = g.size();
+	PathCounts pc;
+	pc.count.assign(n, 0);
+	pc.unbounded.assign(n, 0);
+	if (target < 0)
+		return pc;
+
+	// Nodes that reach target, by a backward search over the input lists.
+	vector<char> reaches(n, 0);
+	vector<int> stack = { target };
+	reaches[target] = 1;
+	while (!stack.empty()) {
+		int v = stack.back();
+		stack.pop_back();
+		for (int k = g.in_offsets[v]; k < g.in_offsets[v + 1]; ++k) {
+			int u = g.in_sources[k];
+			if (!reaches[u]) {
+				reaches[u] = 1;
+				stack.push_back(u);
+			}
 		}
 	}
-	return memo_map[{u, target}] = paths;
+
+	// Outputs still to be counted per node; target counts as finished.
+	vector<int> pending(n, 0);
+	for (int u = 0; u < n; ++u) {
+		if (!reaches[u] || u == target)
+			continue;
+		for (int k = g.out_offsets[u]; k < g.out_offsets[u + 1]; ++k)
+			pending[u] += reaches[g.out_targets[k]];
+	}
+
+	pc.count[target] = 1;
+	vector<int> ready = { target };
+	while (!ready.empty()) {
+		int v = ready.back();
+		ready.pop_back();
+		for (int k = g.in_offsets[v]; k < g.in_offsets[v + 1]; ++k) {
+			int u = g.in_sources[k];
+			if (u == target)
+				continue;
+			pc.count[u] += pc.count[v];
+			if (--pending[u] == 0)
+				ready.push_back(u);
+		}
+	}
+
+	for (int u = 0; u < n; ++u) {
+		if (reaches[u] && pending[u] > 0)
+			pc.unbounded[u] = 1;
+	}
+	return pc;
+}
+
+// Paths from one named device to another, or -1 if a cycle makes them
+// unbounded.
+long long count_paths(const Graph& g, const string& from, const string& to) {
+	if (from == to)
+		return 1;
+	int u = g.id(from);
+	if (u < 0)
+		return 0;
+	PathCounts pc = count_paths_to(g, g.id(to));
+	if (pc.unbounded[u]) {
+		cerr << "Cycle between " << from << " and " << to
+			<< ": infinitely many paths" << endl;
+		return -1;
+	}
+	return pc.count[u];
 }
 
-void solve_part1() {
-	memo_map.clear();
-	cout << count_paths("you", "out") << endl;
+void solve_part1(const Graph& g) {
+	long long paths = count_paths(g, "you", "out");
+	if (paths >= 0)
+		cout << paths << endl;
 }
 
-void solve_part2() {
-	memo_map.clear();
-	// Path 1: svr -> dac -> fft -> out
-	long long p1 = count_paths("svr", "dac") * count_paths("dac", "fft") *
-		count_paths("fft", "out");
+// Products and sums of path counts where -1 stands for unboundedly many.
+// No path times any number of paths is still no path.
+long long mul_paths(long long a, long long b) {
+	if (a == 0 || b == 0)
+		return 0;
+	return (a < 0 || b < 0) ? -1 : a * b;
+}
+
+long long add_paths(long long a, long long b) {
+	return (a < 0 || b < 0) ? -1 : a + b;
+}
+
+// Paths from source to sink that pass through every waypoint, either in the
+// given order or in any order; -1 if a cycle makes them unbounded.
+//
+// One backward count per waypoint and one for the sink give every entry of
+// the transfer table between source, waypoints and sink, so the graph is
+// walked k + 1 times whatever the order. In any order, paths are then
+// combined by a DP over (set of waypoints visited, last waypoint) instead of
+// trying all k! orders. In a DAG a path meets each node at most once, so
+// the orders never count a path twice, as long as the waypoints are distinct
+// and are neither the source nor the sink.
+//
+// The DP table has 2^k rows, so any order is limited to this many waypoints.
+const int MAX_ANY_ORDER_WAYPOINTS = 20;
 
-	// Path 2: svr -> fft -> dac -> out
-	long long p2 = count_paths("svr", "fft") * count_paths("fft", "dac") *
-		count_paths("dac", "out");
+long long count_waypoint_paths(const Graph& g, const string& source,
+	const vector<string>& waypoints, const string& sink, bool any_order) {
+	int k = waypoints.size();
+	vector<string> stops = { source };
+	stops.insert(stops.end(), waypoints.begin(), waypoints.end());
+	stops.push_back(sink);
+
+	// table[a][b]: paths from stops[a] to stops[b], for b past the source.
+	vector<vector<long long>> table(k + 2, vector<long long>(k + 2, 0));
+	for (int b = 1; b <= k + 1; ++b) {
+		PathCounts pc = count_paths_to(g, g.id(stops[b]));
+		for (int a = 0; a <= k; ++a) {
+			int u = g.id(stops[a]);
+			if (stops[a] == stops[b])
+				table[a][b] = 1;
+			else if (u >= 0)
+				table[a][b] = pc.unbounded[u] ? -1 : pc.count[u];
+		}
+	}
 
-	cout << p1 + p2 << endl;
+	if (!any_order) {
+		long long paths = 1;
+		for (int a = 0; a <= k; ++a)
+			paths = mul_paths(paths, table[a][a + 1]);
+		return paths;
+	}
+	if (k == 0)
+		return table[0][1];
+
+	// ways[mask][i]: paths from the source through the waypoints in mask,
+	// ending at waypoint i (table index i + 1).
+	vector<vector<long long>> ways(1 << k, vector<long long>(k, 0));
+	for (int i = 0; i < k; ++i)
+		ways[1 << i][i] = table[0][i + 1];
+	for (int mask = 1; mask < (1 << k); ++mask) {
+		for (int i = 0; i < k; ++i) {
+			if (!(mask >> i & 1) || ways[mask][i] == 0)
+				continue;
+			for (int j = 0; j < k; ++j) {
+				if (mask >> j & 1)
+					continue;
+				long long& next = ways[mask | 1 << j][j];
+				next = add_paths(next, mul_paths(ways[mask][i], table[i + 1][j + 1]));
+			}
+		}
+	}
+	long long paths = 0;
+	for (int i = 0; i < k; ++i)
+		paths = add_paths(paths, mul_paths(ways[(1 << k) - 1][i], table[i + 1][k + 1]));
+	return paths;
+}
+
+void solve_part2(const Graph& g, const vector<string>& waypoints,
+	bool ordered) {
+	long long paths = count_waypoint_paths(g, "svr", waypoints, "out", !ordered);
+	if (paths < 0)
+		cerr << "Cycle between svr and out: infinitely many paths" << endl;
+	else
+		cout << paths << endl;
 }
 
 int main(int argc, char* argv[]) {
 	string filename = "input.txt";
-	if (argc > 1) {
-		filename = argv[1];
+	bool has_file = false;
+	// Part 2 waypoints, visited in any order unless --ordered is given.
+	vector<string> waypoints = { "dac", "fft" };
+	bool ordered = false;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--via" && i + 1 < argc) {
+			waypoints.clear();
+			stringstream ss(argv[++i]);
+			string name;
+			while (getline(ss, name, ',')) {
+				if (!name.empty())
+					waypoints.push_back(name);
+			}
+		}
+		else if (arg == "--ordered") {
+			ordered = true;
+		}
+		else {
+			filename = arg;
+			has_file = true;
+		}
+	}
+
+	// A waypoint repeated back to back is visited once. In any order, so is
+	// any repeat, and svr and out are visited anyway.
+	if (ordered) {
+		waypoints.erase(unique(waypoints.begin(), waypoints.end()),
+			waypoints.end());
+	}
+	else {
+		vector<string> distinct;
+		for (const string& name : waypoints) {
+			if (name != "svr" && name != "out" &&
+				find(distinct.begin(), distinct.end(), name) == distinct.end())
+				distinct.push_back(name);
+		}
+		waypoints = distinct;
+		if ((int)waypoints.size() > MAX_ANY_ORDER_WAYPOINTS) {
+			cerr << "At most " << MAX_ANY_ORDER_WAYPOINTS
+				<< " waypoints in any order; pass --ordered for more" << endl;
+			return 1;
+		}
 	}
 
 	ifstream infile(filename);
 	istream* input_stream = &cin;
-	if (filename != "input.txt" || argc > 1) {
+	if (filename != "input.txt" || has_file) {
 		if (!infile) {
 			cerr << "Error opening file: " << filename << endl;
 			return 1;
@@ -71,18 +306,20 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
+	Graph graph;
+	vector<pair<int, int>> edges;
 	while (getline(graph_in, line)) {
 		if (line.empty())
 			continue;
 		size_t colon_pos = line.find(':');
-		string src = line.substr(0, colon_pos);
-		string dests_str = line.substr(colon_pos + 1);
-		stringstream ss(dests_str);
+		int src = graph.intern(line.substr(0, colon_pos));
+		stringstream ss(line.substr(colon_pos + 1));
 		string dest;
 		while (ss >> dest) {
-			adj[src].push_back(dest);
+			edges.push_back({ src, graph.intern(dest) });
 		}
 	}
+	graph.build(edges);
 
 	int part;
 	cout << "Select part (1 or 2): ";
@@ -92,10 +329,10 @@ int main(int argc, char* argv[]) {
 	}
 
 	if (part == 1) {
-		solve_part1();
+		solve_part1(graph);
 	}
 	else if (part == 2) {
-		solve_part2();
+		solve_part2(graph, waypoints, ordered);
 	}
 	else {
 		cerr << "Invalid part" << endl;
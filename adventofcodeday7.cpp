@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <random>
 #include <set>
 #include <string>
 #include <vector>
@@ -44,52 +46,509 @@ long long solve_part1(const vector<string>& grid, int start_row,
 	return split_count;
 }
 
+// Part 2 beam frontier. While only a few beams are active on a very wide grid
+// the frontier is a sorted list of (column, count) pairs merged row by row;
+// once more than 1/DENSE_OCCUPANCY_DIVISOR of the columns are occupied it
+// switches to a dense per-column array, scanned only over the active window.
+enum FrontierMode { FRONTIER_ADAPTIVE, FRONTIER_SPARSE, FRONTIER_DENSE };
+
+const int DENSE_OCCUPANCY_DIVISOR = 16;
+
+// Adds a beam to a column-sorted frontier. Beams are emitted in nearly sorted
+// order (a split can land at most one column left of the previous emission),
+// so the insertion point is always within a couple of slots of the end.
+void add_to_frontier(vector<pair<int, long long>>& frontier, int col,
+	long long count) {
+	size_t pos = frontier.size();
+	while (pos > 0 && frontier[pos - 1].first > col)
+		--pos;
+	if (pos > 0 && frontier[pos - 1].first == col)
+		frontier[pos - 1].second += count;
+	else
+		frontier.insert(frontier.begin() + pos, { col, count });
+}
+
 long long solve_part2(const vector<string>& grid, int start_row,
-	int start_col) {
+	int start_col, FrontierMode mode = FRONTIER_ADAPTIVE) {
 	int rows = grid.size();
 	int cols = grid[0].size();
-	map<int, long long> active_counts;
-	active_counts[start_col] = 1;
+
+	vector<pair<int, long long>> sparse, next_sparse;
+	vector<long long> dense, next_dense;
+	int lo = start_col, hi = start_col; // active window of the dense frontier
+	bool is_dense = false;
+
+	if (mode == FRONTIER_DENSE) {
+		dense.assign(cols, 0);
+		next_dense.assign(cols, 0);
+		dense[start_col] = 1;
+		is_dense = true;
+	}
+	else {
+		sparse.push_back({ start_col, 1 });
+	}
 
 	for (int r = start_row + 1; r < rows; ++r) {
-		map<int, long long> next_active_counts;
-		if (active_counts.empty())
+		const string& row = grid[r];
+
+		if (!is_dense) {
+			if (sparse.empty())
+				break;
+
+			next_sparse.clear();
+			for (auto const& [c, count] : sparse) {
+				if (c < (int)row.size() && row[c] == '^') {
+					if (c - 1 >= 0)
+						add_to_frontier(next_sparse, c - 1, count);
+					if (c + 1 < cols)
+						add_to_frontier(next_sparse, c + 1, count);
+				}
+				else {
+					add_to_frontier(next_sparse, c, count);
+				}
+			}
+			swap(sparse, next_sparse);
+
+			if (mode == FRONTIER_ADAPTIVE && !sparse.empty() &&
+				(long long)sparse.size() * DENSE_OCCUPANCY_DIVISOR > cols) {
+				dense.assign(cols, 0);
+				next_dense.assign(cols, 0);
+				for (auto const& [c, count] : sparse)
+					dense[c] = count;
+				lo = sparse.front().first;
+				hi = sparse.back().first;
+				is_dense = true;
+			}
+			continue;
+		}
+
+		if (lo > hi)
 			break;
 
-		for (auto const& [c, count] : active_counts) {
-			if (c < 0 || c >= cols)
+		int next_lo = max(lo - 1, 0);
+		int next_hi = min(hi + 1, cols - 1);
+		fill(next_dense.begin() + next_lo, next_dense.begin() + next_hi + 1, 0);
+		for (int c = lo; c <= hi; ++c) {
+			long long count = dense[c];
+			if (count == 0)
 				continue;
 
-			char cell = grid[r][c];
-			if (cell == '^') {
+			if (c < (int)row.size() && row[c] == '^') {
+				if (c - 1 >= 0)
+					next_dense[c - 1] += count;
+				if (c + 1 < cols)
+					next_dense[c + 1] += count;
+			}
+			else {
+				next_dense[c] += count;
+			}
+		}
+		swap(dense, next_dense);
+
+		lo = next_lo;
+		hi = next_hi;
+		while (lo <= hi && dense[lo] == 0)
+			lo++;
+		while (hi >= lo && dense[hi] == 0)
+			hi--;
+	}
+
+	long long total_timelines = 0;
+	if (is_dense) {
+		for (int c = lo; c <= hi; ++c) {
+			total_timelines += dense[c];
+		}
+	}
+	else {
+		for (auto const& [c, count] : sparse) {
+			total_timelines += count;
+		}
+	}
+	return total_timelines;
+}
+
+// Part 2 for every entry column at once.
+// The timeline count is linear in the starting beam, so instead of pushing one
+// beam down from S we pull counts up from the bottom: ways[c] is the number of
+// timelines for a beam entering the current row at column c. A beam leaving
+// the bottom of the grid is exactly one timeline.
+vector<long long> solve_part2_all_columns(const vector<string>& grid,
+	int start_row) {
+	int rows = grid.size();
+	int cols = grid[0].size();
+	vector<long long> ways(cols, 1);
+	vector<long long> next_ways(cols);
+
+	for (int r = rows - 1; r > start_row; --r) {
+		const string& row = grid[r];
+		for (int c = 0; c < cols; ++c) {
+			if (c < (int)row.size() && row[c] == '^') {
+				long long left = (c - 1 >= 0) ? ways[c - 1] : 0;
+				long long right = (c + 1 < cols) ? ways[c + 1] : 0;
+				next_ways[c] = left + right;
+			}
+			else {
+				next_ways[c] = ways[c];
+			}
+		}
+		swap(ways, next_ways);
+	}
+	return ways;
+}
+
+// Periodic manifolds: the rows below S are one block of rows tiled many times.
+// Part 2 is linear in the beam vector, so the block is a cols x cols transfer
+// matrix (entry [a][b] counts the ways a beam entering the block at column a
+// leaves it at column b) and the whole tiling is that matrix raised to the
+// repeat count by squaring. Without a modulus the counts saturate at
+// COUNT_OVERFLOW: every count is a sum of products of non-negative terms, so
+// a saturated value means the true count does not fit in 64 bits, and any
+// other value is exact. A modulus must fit in 32 bits so products cannot
+// overflow.
+struct TransferMatrix {
+	int n;
+	vector<unsigned long long> data; // row-major n x n
+
+	TransferMatrix(int size) : n(size), data((size_t)size * size, 0) {}
+
+	unsigned long long& at(int r, int c) { return data[(size_t)r * n + c]; }
+	unsigned long long at(int r, int c) const {
+		return data[(size_t)r * n + c];
+	}
+};
+
+const unsigned long long COUNT_OVERFLOW = numeric_limits<unsigned long long>::max();
+
+unsigned long long add_mod(unsigned long long a, unsigned long long b,
+	unsigned long long mod) {
+	if (mod)
+		return (a + b) % mod;
+	unsigned long long sum;
+	return __builtin_add_overflow(a, b, &sum) ? COUNT_OVERFLOW : sum;
+}
+
+unsigned long long mul_mod(unsigned long long a, unsigned long long b,
+	unsigned long long mod) {
+	if (mod)
+		return (a * b) % mod;
+	unsigned long long product;
+	return __builtin_mul_overflow(a, b, &product) ? COUNT_OVERFLOW : product;
+}
+
+// Pushes beam counts through a single row.
+vector<unsigned long long> step_row(const string& row,
+	const vector<unsigned long long>& counts,
+	unsigned long long mod) {
+	int cols = counts.size();
+	vector<unsigned long long> next_counts(cols, 0);
+	for (int c = 0; c < cols; ++c) {
+		if (counts[c] == 0)
+			continue;
+		if (c < (int)row.size() && row[c] == '^') {
+			if (c - 1 >= 0)
+				next_counts[c - 1] = add_mod(next_counts[c - 1], counts[c], mod);
+			if (c + 1 < cols)
+				next_counts[c + 1] = add_mod(next_counts[c + 1], counts[c], mod);
+		}
+		else {
+			next_counts[c] = add_mod(next_counts[c], counts[c], mod);
+		}
+	}
+	return next_counts;
+}
+
+TransferMatrix build_block_transfer(const vector<string>& grid, int first_row,
+	int block_rows, int cols,
+	unsigned long long mod) {
+	TransferMatrix t(cols);
+	for (int a = 0; a < cols; ++a) {
+		vector<unsigned long long> counts(cols, 0);
+		counts[a] = 1;
+		for (int r = first_row; r < first_row + block_rows; ++r) {
+			counts = step_row(grid[r], counts, mod);
+		}
+		for (int b = 0; b < cols; ++b) {
+			t.at(a, b) = counts[b];
+		}
+	}
+	return t;
+}
+
+TransferMatrix multiply(const TransferMatrix& x, const TransferMatrix& y,
+	unsigned long long mod) {
+	int n = x.n;
+	TransferMatrix z(n);
+	for (int i = 0; i < n; ++i) {
+		for (int k = 0; k < n; ++k) {
+			unsigned long long xik = x.at(i, k);
+			if (xik == 0)
+				continue;
+			for (int j = 0; j < n; ++j) {
+				z.at(i, j) = add_mod(z.at(i, j), mul_mod(xik, y.at(k, j), mod), mod);
+			}
+		}
+	}
+	return z;
+}
+
+vector<unsigned long long> multiply(const vector<unsigned long long>& v,
+	const TransferMatrix& m,
+	unsigned long long mod) {
+	int n = m.n;
+	vector<unsigned long long> res(n, 0);
+	for (int k = 0; k < n; ++k) {
+		if (v[k] == 0)
+			continue;
+		for (int j = 0; j < n; ++j) {
+			res[j] = add_mod(res[j], mul_mod(v[k], m.at(k, j), mod), mod);
+		}
+	}
+	return res;
+}
+
+// Smallest p such that every row after first_row equals the row p above it,
+// found with the KMP failure function over whole rows. The body is then the
+// first p rows repeated, plus a partial copy at the end.
+int find_row_period(const vector<string>& grid, int first_row) {
+	int body_rows = grid.size() - first_row;
+	if (body_rows <= 0)
+		return 1;
+	vector<int> fail(body_rows, 0);
+	for (int i = 1; i < body_rows; ++i) {
+		int k = fail[i - 1];
+		while (k > 0 && grid[first_row + i] != grid[first_row + k])
+			k = fail[k - 1];
+		if (grid[first_row + i] == grid[first_row + k])
+			k++;
+		fail[i] = k;
+	}
+	return body_rows - fail[body_rows - 1];
+}
+
+// The rows [block_start, block_start + block_rows) are applied repeat times,
+// followed by tail_rows further rows of the block.
+unsigned long long solve_part2_periodic(const vector<string>& grid,
+	int block_start, int block_rows,
+	long long repeat, int tail_rows,
+	int start_col, unsigned long long mod) {
+	int cols = grid[0].size();
+	vector<unsigned long long> counts(cols, 0);
+	counts[start_col] = mod ? 1 % mod : 1;
+
+	if (block_rows > 0 && repeat > 0) {
+		TransferMatrix power =
+			build_block_transfer(grid, block_start, block_rows, cols, mod);
+		while (repeat > 0) {
+			if (repeat & 1)
+				counts = multiply(counts, power, mod);
+			repeat >>= 1;
+			if (repeat > 0)
+				power = multiply(power, power, mod);
+		}
+	}
+	for (int r = block_start; r < block_start + tail_rows; ++r) {
+		counts = step_row(grid[r], counts, mod);
+	}
+
+	unsigned long long total_timelines = 0;
+	for (unsigned long long count : counts) {
+		total_timelines = add_mod(total_timelines, count, mod);
+	}
+	return total_timelines;
+}
+
+// Streaming mode: rows are consumed one at a time straight from the input and
+// only the beam state of the current row is kept, so memory is O(width)
+// regardless of the manifold height.
+bool find_start_stream(istream& in, int& cols, int& start_col) {
+	string line;
+	while (getline(in, line)) {
+		size_t found = line.find('S');
+		if (found != string::npos) {
+			cols = line.size();
+			start_col = found;
+			return true;
+		}
+	}
+	return false;
+}
+
+long long solve_part1_stream(istream& in, int cols, int start_col) {
+	vector<char> active(cols, 0);
+	vector<char> next_active(cols);
+	active[start_col] = 1;
+	int num_active = 1;
+
+	long long split_count = 0;
+	string line;
+	while (num_active > 0 && getline(in, line)) {
+		fill(next_active.begin(), next_active.end(), 0);
+		num_active = 0;
+		for (int c = 0; c < cols; ++c) {
+			if (!active[c])
+				continue;
+
+			if (c < (int)line.size() && line[c] == '^') {
+				split_count++;
+				if (c - 1 >= 0)
+					next_active[c - 1] = 1;
+				if (c + 1 < cols)
+					next_active[c + 1] = 1;
+			}
+			else {
+				next_active[c] = 1;
+			}
+		}
+		for (int c = 0; c < cols; ++c)
+			num_active += next_active[c];
+		swap(active, next_active);
+	}
+	return split_count;
+}
+
+long long solve_part2_stream(istream& in, int cols, int start_col) {
+	vector<long long> counts(cols, 0);
+	vector<long long> next_counts(cols);
+	counts[start_col] = 1;
+
+	string line;
+	while (getline(in, line)) {
+		fill(next_counts.begin(), next_counts.end(), 0);
+		for (int c = 0; c < cols; ++c) {
+			long long count = counts[c];
+			if (count == 0)
+				continue;
+
+			if (c < (int)line.size() && line[c] == '^') {
 				if (c - 1 >= 0)
-					next_active_counts[c - 1] += count;
+					next_counts[c - 1] += count;
 				if (c + 1 < cols)
-					next_active_counts[c + 1] += count;
+					next_counts[c + 1] += count;
 			}
 			else {
-				next_active_counts[c] += count;
+				next_counts[c] += count;
 			}
 		}
-		active_counts = next_active_counts;
+		swap(counts, next_counts);
 	}
 
 	long long total_timelines = 0;
-	for (auto const& [c, count] : active_counts) {
+	for (long long count : counts) {
 		total_timelines += count;
 	}
 	return total_timelines;
 }
 
+// Times part 2 with each frontier representation, averaged over iterations.
+void time_frontier_modes(const string& label, const vector<string>& grid,
+	int start_row, int start_col, int iterations) {
+	const pair<const char*, FrontierMode> modes[] = {
+		{"adaptive", FRONTIER_ADAPTIVE},
+		{"sparse", FRONTIER_SPARSE},
+		{"dense", FRONTIER_DENSE} };
+	for (auto const& [name, mode] : modes) {
+		long long result = 0;
+		auto t0 = chrono::steady_clock::now();
+		for (int k = 0; k < iterations; ++k)
+			result = solve_part2(grid, start_row, start_col, mode);
+		auto t1 = chrono::steady_clock::now();
+		cout << label << ", " << name << ": " << result << " in "
+			<< chrono::duration<double, milli>(t1 - t0).count() / iterations
+			<< " ms" << endl;
+	}
+}
+
+// Synthetic grid: S in row 0 at column fan_rows + 1, with row 0 padded to
+// cols columns, then fan_rows rows of splitters on alternating columns (each
+// present with probability 3/4) that fan the beam out into a triangle, then
+// flat_rows rows without splitters that only carry the frontier down. The
+// later rows are no wider than the triangle, so a wide grid stays cheap to
+// hold; there are at most 2 * fan_rows + 1 beams and the timelines fit in
+// 64 bits.
+vector<string> bench_grid(mt19937& rng, int cols, int fan_rows,
+	int flat_rows) {
+	int start_col = fan_rows + 1;
+	int width = min(cols, 2 * fan_rows + 3);
+	vector<string> grid = { string(cols, '.') };
+	grid[0][start_col] = 'S';
+	for (int k = 0; k < fan_rows; ++k) {
+		string row(width, '.');
+		for (int c = start_col - k; c <= start_col + k; c += 2) {
+			if (rng() % 4 != 0)
+				row[c] = '^';
+		}
+		grid.push_back(row);
+	}
+	grid.resize(grid.size() + flat_rows, string(width, '.'));
+	return grid;
+}
+
+// Part 2 in both frontier regimes: about a hundred beams on a 10^7 column
+// grid, where the dense array only costs, and the same fan-out filling most
+// of a narrow grid, where the sorted pairs only cost.
+void bench_part2() {
+	const int FAN_ROWS = 60;
+	const int FLAT_ROWS = 4000;
+	mt19937 rng(2025);
+	vector<string> sparse = bench_grid(rng, 10000000, FAN_ROWS, FLAT_ROWS);
+	time_frontier_modes("10^7 columns", sparse, 0, FAN_ROWS + 1, 5);
+	vector<string> dense = bench_grid(rng, 2 * FAN_ROWS + 3, FAN_ROWS,
+		FLAT_ROWS);
+	time_frontier_modes(to_string(dense[0].size()) + " columns", dense, 0,
+		FAN_ROWS + 1, 50);
+}
+
 int main(int argc, char* argv[]) {
 	string filename = "input.txt";
-	if (argc > 1) {
-		filename = argv[1];
+	bool has_file = false;
+	bool all_columns = false;
+	bool stream = false;
+	bool periodic = false;
+	bool bench = false;
+	long long repeat = 1;
+	unsigned long long mod = 0;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--all-columns") {
+			all_columns = true;
+		}
+		else if (arg == "--stream") {
+			stream = true;
+		}
+		else if (arg == "--bench") {
+			bench = true;
+		}
+		else if (arg == "--periodic") {
+			periodic = true;
+		}
+		else if (arg == "--repeat" && i + 1 < argc) {
+			repeat = stoll(argv[++i]);
+			periodic = true;
+		}
+		else if (arg == "--mod" && i + 1 < argc) {
+			mod = stoull(argv[++i]);
+			if (mod > numeric_limits<unsigned int>::max()) {
+				cerr << "Modulus must fit in 32 bits." << endl;
+				return 1;
+			}
+			periodic = true;
+		}
+		else {
+			filename = arg;
+			has_file = true;
+		}
+	}
+
+	// Without an input file --bench only runs the synthetic grids.
+	if (bench) {
+		bench_part2();
+		if (!has_file)
+			return 0;
 	}
 
 	ifstream infile(filename);
 	istream* input = &cin;
-	if (filename != "input.txt" || argc > 1) {
+	if (has_file) {
 		if (!infile) {
 			cerr << "Error opening file: " << filename << endl;
 			return 1;
@@ -97,6 +556,37 @@ int main(int argc, char* argv[]) {
 		input = &infile;
 	}
 
+	if (stream) {
+		// The grid is never stored, so the part has to be known before reading
+		// it. When piping through stdin, the part goes on the first line.
+		int part;
+		cout << "Select part (1 or 2): ";
+		if (!(cin >> part)) {
+			cerr << "Invalid input for part selection." << endl;
+			return 1;
+		}
+		if (input == &cin)
+			cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+		int cols = 0, start_col = -1;
+		if (!find_start_stream(*input, cols, start_col)) {
+			cerr << "Start point S not found." << endl;
+			return 0;
+		}
+
+		if (part == 1) {
+			cout << solve_part1_stream(*input, cols, start_col) << endl;
+		}
+		else if (part == 2) {
+			cout << solve_part2_stream(*input, cols, start_col) << endl;
+		}
+		else {
+			cerr << "Invalid part selected." << endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	vector<string> grid;
 	string line;
 	while (getline(*input, line)) {
@@ -122,6 +612,11 @@ int main(int argc, char* argv[]) {
 		return 0;
 	}
 
+	if (bench) {
+		time_frontier_modes(filename, grid, start_row, start_col, 1);
+		return 0;
+	}
+
 	if (input == &cin)
 		cin.clear();
 	int part;
@@ -134,6 +629,41 @@ int main(int argc, char* argv[]) {
 	if (part == 1) {
 		cout << solve_part1(grid, start_row, start_col) << endl;
 	}
+	else if (part == 2 && all_columns) {
+		// One line per entry column: "<column> <timelines>"
+		vector<long long> counts = solve_part2_all_columns(grid, start_row);
+		for (size_t c = 0; c < counts.size(); ++c) {
+			cout << c << " " << counts[c] << "\n";
+		}
+	}
+	else if (part == 2 && periodic) {
+		// The rows below S, repeated `repeat` times. If the body is itself a
+		// tiling of a shorter block, exponentiate that block instead.
+		int body_rows = rows - (start_row + 1);
+		int block_rows = body_rows;
+		int tail_rows = 0;
+		int period = find_row_period(grid, start_row + 1);
+		if (repeat == 1) {
+			block_rows = period;
+			repeat = body_rows / period;
+			tail_rows = body_rows % period;
+		}
+		else if (body_rows % period == 0) {
+			block_rows = period;
+			if (__builtin_mul_overflow(repeat, body_rows / period, &repeat)) {
+				cerr << "Repeat count overflows 64 bits." << endl;
+				return 1;
+			}
+		}
+		unsigned long long timelines = solve_part2_periodic(grid, start_row + 1,
+			block_rows, repeat, tail_rows, start_col, mod);
+		if (!mod && timelines == COUNT_OVERFLOW) {
+			cerr << "Timeline count overflows 64 bits; pass --mod to count "
+				"modulo a 32-bit number." << endl;
+			return 1;
+		}
+		cout << timelines << endl;
+	}
 	else if (part == 2) {
 		cout << solve_part2(grid, start_row, start_col) << endl;
 	}
@@ -1,10 +1,16 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 
@@ -20,22 +26,31 @@ struct Edge {
 	long long distSq;
 };
 
+// Parent links are atomics so that find may run on several threads at once
+// (the filter step of filter-Kruskal does this); unite is only ever called
+// from one thread. find is iterative with path halving, so degenerate chains
+// cannot overflow the stack.
 struct DSU {
-	vector<int> parent;
+	vector<atomic<int>> parent;
 	vector<int> size;
 	int num_components;
 
-	DSU(int n) {
-		parent.resize(n);
-		iota(parent.begin(), parent.end(), 0);
+	DSU(int n) : parent(n) {
+		for (int i = 0; i < n; ++i)
+			parent[i].store(i, memory_order_relaxed);
 		size.assign(n, 1);
 		num_components = n;
 	}
 
 	int find(int i) {
-		if (parent[i] == i)
-			return i;
-		return parent[i] = find(parent[i]);
+		int p = parent[i].load(memory_order_relaxed);
+		while (p != i) {
+			int grandparent = parent[p].load(memory_order_relaxed);
+			parent[i].store(grandparent, memory_order_relaxed);
+			i = grandparent;
+			p = parent[i].load(memory_order_relaxed);
+		}
+		return i;
 	}
 
 	bool unite(int i, int j) {
@@ -44,7 +59,7 @@ struct DSU {
 		if (root_i != root_j) {
 			if (size[root_i] < size[root_j])
 				swap(root_i, root_j);
-			parent[root_j] = root_i;
+			parent[root_j].store(root_i, memory_order_relaxed);
 			size[root_i] += size[root_j];
 			num_components--;
 			return true;
@@ -55,10 +70,14 @@ struct DSU {
 
 bool compareEdges(const Edge& a, const Edge& b) { return a.distSq < b.distSq; }
 
-long long solve_part1(int N, const vector<Edge>& edges, int num_points) {
+// EdgeList is any sorted container with size() and operator[] yielding an
+// Edge: a plain vector<Edge> or the PackedEdges keys below.
+template <class EdgeList>
+long long solve_part1(int N, const EdgeList& edges, int num_points) {
 	DSU dsu(num_points);
 	int connections_made = 0;
-	for (const auto& edge : edges) {
+	for (size_t k = 0; k < edges.size(); ++k) {
+		Edge edge = edges[k];
 		if (connections_made >= N)
 			break;
 		// Part 1 logic: just unite, counting standard connections regardless of
@@ -101,12 +120,14 @@ long long solve_part1(int N, const vector<Edge>& edges, int num_points) {
 	return result;
 }
 
-long long solve_part2(const vector<Edge>& edges, int num_points,
+template <class EdgeList>
+long long solve_part2(const EdgeList& edges, int num_points,
 	const vector<Point>& points) {
 	DSU dsu(num_points);
 	int last_u = -1, last_v = -1;
 
-	for (const auto& edge : edges) {
+	for (size_t k = 0; k < edges.size(); ++k) {
+		Edge edge = edges[k];
 		if (dsu.unite(edge.u, edge.v)) {
 			last_u = edge.u;
 			last_v = edge.v;
@@ -121,25 +142,1147 @@ long long solve_part2(const vector<Edge>& edges, int num_points,
 	return 0;
 }
 
+// Part 1 answer for every connection budget N in one Kruskal pass. Circuit
+// sizes of 2 or more are kept in a multiset next to the DSU (singletons are
+// just counted), so the top three are read off its end after each edge.
+// The curve is a step function and is written as CSV rows
+// "connections,product" only where the product changes: each value holds up
+// to the next row. Once everything is one circuit nothing can change any
+// more, so the pass stops there. Returns the number of rows written.
+template <class EdgeList>
+size_t write_circuit_curve(const EdgeList& edges, int num_points,
+	ostream& out) {
+	DSU dsu(num_points);
+	multiset<int> sizes;
+	int singletons = num_points;
+
+	auto top3_product = [&]() {
+		long long result = 1;
+		int taken = 0;
+		for (auto it = sizes.rbegin(); it != sizes.rend() && taken < 3; ++it) {
+			result *= *it;
+			taken++;
+		}
+		// Remaining factors would be singletons of size 1.
+		return result;
+	};
+
+	out << "connections,product\n";
+	long long current = top3_product();
+	out << 0 << "," << current << "\n";
+	size_t rows = 1;
+
+	for (size_t k = 0; k < edges.size() && dsu.num_components > 1; ++k) {
+		Edge edge = edges[k];
+		int root_u = dsu.find(edge.u);
+		int root_v = dsu.find(edge.v);
+		if (root_u == root_v)
+			continue;
+
+		int size_u = dsu.size[root_u];
+		int size_v = dsu.size[root_v];
+		for (int sz : { size_u, size_v }) {
+			if (sz == 1)
+				singletons--;
+			else
+				sizes.erase(sizes.find(sz));
+		}
+		sizes.insert(size_u + size_v);
+		dsu.unite(root_u, root_v);
+
+		long long product = top3_product();
+		if (product != current) {
+			current = product;
+			out << k + 1 << "," << current << "\n";
+			rows++;
+		}
+	}
+	return rows;
+}
+
+// Runs f(t) for t in [0, num_threads), on num_threads - 1 extra threads plus
+// the calling one.
+template <class F> void run_threads(int num_threads, F f) {
+	vector<thread> threads;
+	for (int t = 1; t < num_threads; ++t)
+		threads.emplace_back(f, t);
+	f(0);
+	for (thread& t : threads)
+		t.join();
+}
+
+// Full edge list, for when every pair really is needed. Coordinates are
+// copied into structure-of-arrays form so the inner loop over j is a plain
+// stride-1 loop; distances for a tile of columns are computed into a scratch
+// buffer and handed to emit(i, j_first, dist, len) for pairs (i, j_first + k).
+// Pair (i, j) has the fixed index row_start(i) + (j - i - 1), so callers
+// write straight into pre-sized output and threads never share an output
+// range. Rows are handed out in blocks from an atomic counter; the first
+// blocks are the longest, which keeps the threads balanced.
+//
+// x86-64 without AVX-512 has no packed 64-bit integer multiply, so on the
+// baseline target the kernel only vectorises (SSE2, at -O3) in doubles.
+// Doubles are exact while every squared distance stays below 2^53, which
+// holds whenever the squared bounding box diagonal does; otherwise the same
+// loop runs in long long, unvectorised. emit receives a pointer to whichever
+// type was used.
+template <class T> struct PointsSoA {
+	vector<T> x, y, z;
+
+	PointsSoA(const vector<Point>& points) {
+		x.reserve(points.size());
+		y.reserve(points.size());
+		z.reserve(points.size());
+		for (const Point& p : points) {
+			x.push_back(p.x);
+			y.push_back(p.y);
+			z.push_back(p.z);
+		}
+	}
+
+	// Squared distances from point i to points js..js+len-1, into d.
+	void distances(int i, int js, int len, T* __restrict d) const {
+		const T* __restrict xs = x.data() + js;
+		const T* __restrict ys = y.data() + js;
+		const T* __restrict zs = z.data() + js;
+		T xi = x[i], yi = y[i], zi = z[i];
+		for (int k = 0; k < len; ++k) {
+			T dx = xi - xs[k];
+			T dy = yi - ys[k];
+			T dz = zi - zs[k];
+			d[k] = dx * dx + dy * dy + dz * dz;
+		}
+	}
+};
+
+size_t row_start(size_t i, size_t n) { return i * (2 * n - i - 1) / 2; }
+
+// Squared length of the bounding box diagonal, an upper bound on every
+// squared distance; saturates instead of overflowing.
+unsigned long long max_squared_distance(const vector<Point>& points) {
+	if (points.empty())
+		return 0;
+	long long lo[3] = { points[0].x, points[0].y, points[0].z };
+	long long hi[3] = { points[0].x, points[0].y, points[0].z };
+	for (const Point& p : points) {
+		long long c[3] = { p.x, p.y, p.z };
+		for (int dim = 0; dim < 3; ++dim) {
+			lo[dim] = min(lo[dim], c[dim]);
+			hi[dim] = max(hi[dim], c[dim]);
+		}
+	}
+	unsigned long long total = 0;
+	for (int dim = 0; dim < 3; ++dim) {
+		unsigned long long extent = hi[dim] - lo[dim];
+		unsigned long long sq;
+		if (__builtin_mul_overflow(extent, extent, &sq) ||
+			__builtin_add_overflow(total, sq, &total))
+			return numeric_limits<unsigned long long>::max();
+	}
+	return total;
+}
+
+template <class T, class Emit>
+void for_each_edge_tile_as(const vector<Point>& points, int num_threads,
+	Emit& emit) {
+	const int ROW_BLOCK = 32;
+	const int COL_TILE = 2048;
+
+	int n = points.size();
+	PointsSoA<T> soa(points);
+
+	atomic<int> next_block(0);
+	run_threads(num_threads, [&](int) {
+		vector<T> dist(COL_TILE);
+		T* d = dist.data();
+		for (;;) {
+			int i0 = next_block.fetch_add(1) * ROW_BLOCK;
+			if (i0 >= n)
+				break;
+			int i1 = min(n, i0 + ROW_BLOCK);
+			for (int j0 = i0 + 1; j0 < n; j0 += COL_TILE) {
+				int j1 = min(n, j0 + COL_TILE);
+				for (int i = i0; i < i1; ++i) {
+					int js = max(j0, i + 1);
+					if (js >= j1)
+						continue;
+					int len = j1 - js;
+					soa.distances(i, js, len, d);
+					emit(i, js, (const T*)d, len);
+				}
+			}
+		}
+		});
+}
+
+template <class Emit>
+void for_each_edge_tile(const vector<Point>& points, int num_threads,
+	Emit emit) {
+	if (max_squared_distance(points) < (1ULL << 53))
+		for_each_edge_tile_as<double>(points, num_threads, emit);
+	else
+		for_each_edge_tile_as<long long>(points, num_threads, emit);
+}
+
+vector<Edge> build_all_edges(const vector<Point>& points, int num_threads) {
+	int n = points.size();
+	vector<Edge> edges((size_t)n * (n > 0 ? n - 1 : 0) / 2);
+	for_each_edge_tile(points, num_threads,
+		[&](int i, int js, const auto* d, int len) {
+			Edge* out = edges.data() + row_start(i, n) + (js - i - 1);
+			for (int k = 0; k < len; ++k) {
+				out[k] = { i, js + k, (long long)d[k] };
+			}
+		});
+	return edges;
+}
+
+// Packed edges: one 64-bit key per pair, (distSq << pair_bits) | pair index.
+// The pair index enumerates pairs in (u, v) order, so sorting the keys as
+// plain integers orders edges by distance with ties broken by (u, v), the
+// same order as edge_less. Only usable when the largest possible distance
+// and the pair count fit in 64 bits together; the caller checks fits().
+struct PackedEdges {
+	int n;
+	int pair_bits;
+	int key_bits;
+	vector<unsigned long long> keys;
+
+	static int bit_width(unsigned long long v) {
+		int bits = 0;
+		while (v) {
+			bits++;
+			v >>= 1;
+		}
+		return bits;
+	}
+
+	PackedEdges(const vector<Point>& points) : n(points.size()) {
+		size_t pairs = (size_t)n * (n > 0 ? n - 1 : 0) / 2;
+		pair_bits = bit_width(pairs > 0 ? pairs - 1 : 0);
+		// Bound the distance by the bounding box diagonal; a saturated bound
+		// means the distances alone may need more than 64 bits.
+		unsigned long long max_dist = max_squared_distance(points);
+		if (max_dist == numeric_limits<unsigned long long>::max())
+			key_bits = 65;
+		else
+			key_bits = pair_bits + bit_width(max_dist);
+	}
+
+	bool fits() const { return key_bits <= 64; }
+
+	void build(const vector<Point>& points, int num_threads) {
+		keys.resize((size_t)n * (n > 0 ? n - 1 : 0) / 2);
+		int shift = pair_bits;
+		for_each_edge_tile(points, num_threads,
+			[&](int i, int js, const auto* d, int len) {
+				size_t first = row_start(i, n) + (js - i - 1);
+				unsigned long long* out = keys.data() + first;
+				for (int k = 0; k < len; ++k) {
+					out[k] = ((unsigned long long)d[k] << shift) | (first + k);
+				}
+			});
+	}
+
+	size_t size() const { return keys.size(); }
+
+	Edge operator[](size_t k) const { return decode(keys[k]); }
+
+	Edge decode(unsigned long long key) const {
+		size_t index = key & ((1ULL << pair_bits) - 1);
+		// Invert row_start: estimate the row from the quadratic, then correct.
+		double b = 2.0 * n - 1;
+		long long i = (long long)((b - sqrt(max(0.0, b * b - 8.0 * index))) / 2);
+		i = max(0LL, min(i, (long long)n - 2));
+		while (i > 0 && row_start(i, n) > index)
+			i--;
+		while (i + 1 < n - 1 && row_start(i + 1, n) <= index)
+			i++;
+		int v = i + 1 + (index - row_start(i, n));
+		return { (int)i, v, (long long)(key >> pair_bits) };
+	}
+};
+
+// Stable LSD radix sort on bits [low_bit, high_bit) of the keys. The packed
+// keys are generated in pair-index order, so sorting just the distance bits
+// stably already leaves ties ordered by (u, v). The bit range is split into
+// as few passes of at most MAX_DIGIT_BITS as possible. Each thread histograms
+// its own slice, the per-(digit, thread) offsets are laid out digit-major so
+// the scatter stays stable, and passes where every key has the same digit
+// are skipped.
+void radix_sort_keys(vector<unsigned long long>& keys, int low_bit,
+	int high_bit, int num_threads) {
+	const int MAX_DIGIT_BITS = 12;
+	size_t n = keys.size();
+	if (n < 2 || high_bit <= low_bit)
+		return;
+	int passes = (high_bit - low_bit + MAX_DIGIT_BITS - 1) / MAX_DIGIT_BITS;
+	int digit_bits = (high_bit - low_bit + passes - 1) / passes;
+	size_t radix = (size_t)1 << digit_bits;
+
+	num_threads = (int)min<size_t>(num_threads, max<size_t>(1, n / 65536));
+	vector<unsigned long long> buffer(n);
+	vector<size_t> offsets(num_threads * radix);
+	auto slice_begin = [&](int t) { return n * t / num_threads; };
+
+	for (int shift = low_bit; shift < high_bit; shift += digit_bits) {
+		fill(offsets.begin(), offsets.end(), 0);
+		run_threads(num_threads, [&](int t) {
+			size_t* count = offsets.data() + t * radix;
+			for (size_t k = slice_begin(t); k < slice_begin(t + 1); ++k)
+				count[(keys[k] >> shift) & (radix - 1)]++;
+			});
+
+		bool single_digit = false;
+		size_t running = 0;
+		for (size_t digit = 0; digit < radix; ++digit) {
+			size_t digit_total = 0;
+			for (int t = 0; t < num_threads; ++t) {
+				size_t c = offsets[t * radix + digit];
+				offsets[t * radix + digit] = running;
+				running += c;
+				digit_total += c;
+			}
+			if (digit_total == n)
+				single_digit = true;
+		}
+		if (single_digit)
+			continue;
+
+		run_threads(num_threads, [&](int t) {
+			size_t* pos = offsets.data() + t * radix;
+			for (size_t k = slice_begin(t); k < slice_begin(t + 1); ++k)
+				buffer[pos[(keys[k] >> shift) & (radix - 1)]++] = keys[k];
+			});
+		swap(keys, buffer);
+	}
+}
+
+// Drops the edges of [first, first + count) whose endpoints are already
+// connected and returns how many are left, compacted to the front in their
+// original order. Each thread compacts its own slice in place (find is safe
+// to call concurrently), then the slices are moved together.
+size_t filter_connected(const PackedEdges& packed, unsigned long long* first,
+	size_t count, DSU& dsu, int num_threads) {
+	num_threads = (int)min<size_t>(num_threads, max<size_t>(1, count / 65536));
+	vector<size_t> kept(num_threads);
+	auto slice_begin = [&](int t) { return count * t / num_threads; };
+	run_threads(num_threads, [&](int t) {
+		size_t out = slice_begin(t);
+		for (size_t k = slice_begin(t); k < slice_begin(t + 1); ++k) {
+			Edge e = packed.decode(first[k]);
+			if (dsu.find(e.u) != dsu.find(e.v))
+				first[out++] = first[k];
+		}
+		kept[t] = out - slice_begin(t);
+		});
+
+	size_t total = kept[0];
+	for (int t = 1; t < num_threads; ++t) {
+		copy(first + slice_begin(t), first + slice_begin(t) + kept[t],
+			first + total);
+		total += kept[t];
+	}
+	return total;
+}
+
+// Filter-Kruskal over unsorted packed keys: split around a sampled pivot key,
+// run on the light half first, then drop heavy edges that would only close a
+// cycle and continue on what is left. Small ranges are sorted and scanned as
+// in plain Kruskal. Keys are unique and ordered like edge_less, so the edges
+// are united in exactly Kruskal's order and `last` ends up as the connection
+// that joins everything.
+void filter_kruskal(const PackedEdges& packed, unsigned long long* first,
+	size_t count, DSU& dsu, int num_threads, Edge& last) {
+	const size_t BASE_CASE = 1 << 16;
+	const int SAMPLES = 31;
+
+	if (count == 0 || dsu.num_components == 1)
+		return;
+	if (count <= BASE_CASE) {
+		sort(first, first + count);
+		for (size_t k = 0; k < count; ++k) {
+			Edge e = packed.decode(first[k]);
+			if (dsu.unite(e.u, e.v)) {
+				last = e;
+				if (dsu.num_components == 1)
+					return;
+			}
+		}
+		return;
+	}
+
+	// Median of evenly spaced samples; with distinct keys both halves are
+	// non-empty.
+	unsigned long long samples[SAMPLES];
+	for (int k = 0; k < SAMPLES; ++k)
+		samples[k] = first[(count - 1) * k / (SAMPLES - 1)];
+	nth_element(samples, samples + SAMPLES / 2, samples + SAMPLES);
+	unsigned long long pivot = samples[SAMPLES / 2];
+
+	unsigned long long* mid = partition(first, first + count,
+		[pivot](unsigned long long key) { return key < pivot; });
+	filter_kruskal(packed, first, mid - first, dsu, num_threads, last);
+	if (dsu.num_components == 1)
+		return;
+
+	size_t heavy = filter_connected(packed, mid, first + count - mid, dsu,
+		num_threads);
+	filter_kruskal(packed, mid, heavy, dsu, num_threads, last);
+}
+
+long long solve_part2_filter_kruskal(PackedEdges& packed,
+	const vector<Point>& points, int num_threads) {
+	DSU dsu(points.size());
+	Edge last = { -1, -1, 0 };
+	filter_kruskal(packed, packed.keys.data(), packed.keys.size(), dsu,
+		num_threads, last);
+	if (last.u == -1)
+		return 0;
+	return (long long)points[last.u].x * points[last.v].x;
+}
+
+// The original one-pair-at-a-time generator, kept as the --bench baseline.
+vector<Edge> build_all_edges_serial(const vector<Point>& points) {
+	vector<Edge> edges;
+	for (int i = 0; i < points.size(); ++i) {
+		for (int j = i + 1; j < points.size(); ++j) {
+			long long dx = points[i].x - points[j].x;
+			long long dy = points[i].y - points[j].y;
+			long long dz = points[i].z - points[j].z;
+			long long distSq = dx * dx + dy * dy + dz * dz;
+			edges.push_back({ i, j, distSq });
+		}
+	}
+	return edges;
+}
+
+// Spatial engines. A k-d tree over the junction boxes lets the answers be
+// found without materialising all n(n-1)/2 pairs. The tree keeps its own copy
+// of the points reordered so that every node covers a contiguous range of
+// `pts` (Point::id still refers to the input index). Nodes live in a flat
+// array in preorder, children after their parent, with their bounding boxes.
+struct KdTree {
+	struct Node {
+		int lo, hi;
+		int left, right; // -1 for leaves
+		int box_min[3], box_max[3];
+	};
+
+	static const int LEAF_SIZE = 16;
+
+	vector<Point> pts;
+	vector<Node> nodes;
+
+	KdTree(const vector<Point>& points) : pts(points) {
+		for (int i = 0; i < (int)pts.size(); ++i)
+			pts[i].id = i;
+		if (!pts.empty())
+			build(0, pts.size());
+	}
+
+	static int coord(const Point& p, int dim) {
+		return dim == 0 ? p.x : (dim == 1 ? p.y : p.z);
+	}
+
+	int build(int lo, int hi) {
+		Node node;
+		node.lo = lo;
+		node.hi = hi;
+		node.left = node.right = -1;
+		for (int d = 0; d < 3; ++d) {
+			node.box_min[d] = node.box_max[d] = coord(pts[lo], d);
+		}
+		for (int i = lo + 1; i < hi; ++i) {
+			for (int d = 0; d < 3; ++d) {
+				int v = coord(pts[i], d);
+				node.box_min[d] = min(node.box_min[d], v);
+				node.box_max[d] = max(node.box_max[d], v);
+			}
+		}
+
+		int id = nodes.size();
+		nodes.push_back(node);
+		if (hi - lo > LEAF_SIZE) {
+			int dim = 0;
+			for (int d = 1; d < 3; ++d) {
+				if ((long long)node.box_max[d] - node.box_min[d] >
+					(long long)node.box_max[dim] - node.box_min[dim])
+					dim = d;
+			}
+			int mid = (lo + hi) / 2;
+			nth_element(pts.begin() + lo, pts.begin() + mid, pts.begin() + hi,
+				[dim](const Point& a, const Point& b) {
+					return coord(a, dim) < coord(b, dim);
+				});
+			int left = build(lo, mid);
+			int right = build(mid, hi);
+			nodes[id].left = left;
+			nodes[id].right = right;
+		}
+		return id;
+	}
+
+	// Squared distance from p to the node's bounding box (0 if inside).
+	long long box_dist_sq(const Node& node, const Point& p) const {
+		long long total = 0;
+		for (int d = 0; d < 3; ++d) {
+			long long v = coord(p, d);
+			long long diff = 0;
+			if (v < node.box_min[d])
+				diff = node.box_min[d] - v;
+			else if (v > node.box_max[d])
+				diff = v - node.box_max[d];
+			total += diff * diff;
+		}
+		return total;
+	}
+};
+
+long long dist_sq(const Point& a, const Point& b) {
+	long long dx = a.x - b.x;
+	long long dy = a.y - b.y;
+	long long dz = a.z - b.z;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Strict total order on edges (distance, then endpoints) so that ties are
+// broken the same way by every engine. Endpoints are stored with u < v.
+bool edge_less(const Edge& a, const Edge& b) {
+	if (a.distSq != b.distSq)
+		return a.distSq < b.distSq;
+	if (a.u != b.u)
+		return a.u < b.u;
+	return a.v < b.v;
+}
+
+// Nearest point to tree.pts[p] outside its component. `comp` is indexed by
+// tree position; subtrees lying entirely inside p's component are skipped.
+// `best` starts out as the best edge found for the component so far, and
+// edges carry input indices so ties break the same way as in Kruskal;
+// `best_q` receives the tree position of the point behind an improved edge.
+// `node_dist` is the squared distance from p to the node's bounding box.
+void nearest_other_component(const KdTree& tree, int node_id,
+	long long node_dist, int p, const vector<int>& comp,
+	const vector<int>& node_comp, Edge& best,
+	int& best_q) {
+	int comp_p = comp[p];
+	if (node_comp[node_id] == comp_p)
+		return;
+	if (best.u != -1 && node_dist > best.distSq)
+		return;
+
+	const KdTree::Node& node = tree.nodes[node_id];
+	const Point& pt = tree.pts[p];
+	if (node.left == -1) {
+		for (int q = node.lo; q < node.hi; ++q) {
+			if (comp[q] == comp_p)
+				continue;
+			long long d = dist_sq(pt, tree.pts[q]);
+			if (best.u != -1 && d > best.distSq)
+				continue;
+			int a = pt.id, b = tree.pts[q].id;
+			Edge candidate = { min(a, b), max(a, b), d };
+			if (best.u == -1 || edge_less(candidate, best)) {
+				best = candidate;
+				best_q = q;
+			}
+		}
+		return;
+	}
+
+	int first = node.left, second = node.right;
+	long long first_dist = tree.box_dist_sq(tree.nodes[first], pt);
+	long long second_dist = tree.box_dist_sq(tree.nodes[second], pt);
+	if (second_dist < first_dist) {
+		swap(first, second);
+		swap(first_dist, second_dist);
+	}
+	nearest_other_component(tree, first, first_dist, p, comp, node_comp, best,
+		best_q);
+	nearest_other_component(tree, second, second_dist, p, comp, node_comp,
+		best, best_q);
+}
+
+// Collects into `heap` (a max-heap under edge_less holding at most N edges)
+// every pair (p, q) with q at a later tree position than p that beats the
+// current N-th best, or `bound` while the heap is not yet full.
+void collect_close_pairs(const KdTree& tree, int node_id, long long node_dist,
+	int p, size_t N, long long bound,
+	vector<Edge>& heap) {
+	const KdTree::Node& node = tree.nodes[node_id];
+	if (node.hi <= p + 1)
+		return;
+	long long limit = (heap.size() == N) ? heap.front().distSq : bound;
+	if (node_dist > limit)
+		return;
+
+	const Point& pt = tree.pts[p];
+	if (node.left == -1) {
+		for (int q = max(node.lo, p + 1); q < node.hi; ++q) {
+			long long d = dist_sq(pt, tree.pts[q]);
+			if (d > limit)
+				continue;
+			int a = pt.id, b = tree.pts[q].id;
+			Edge candidate = { min(a, b), max(a, b), d };
+			if (heap.size() < N) {
+				heap.push_back(candidate);
+				push_heap(heap.begin(), heap.end(), edge_less);
+			}
+			else if (edge_less(candidate, heap.front())) {
+				pop_heap(heap.begin(), heap.end(), edge_less);
+				heap.back() = candidate;
+				push_heap(heap.begin(), heap.end(), edge_less);
+			}
+			if (heap.size() == N)
+				limit = heap.front().distSq;
+		}
+		return;
+	}
+
+	int first = node.left, second = node.right;
+	long long first_dist = tree.box_dist_sq(tree.nodes[first], pt);
+	long long second_dist = tree.box_dist_sq(tree.nodes[second], pt);
+	if (second_dist < first_dist) {
+		swap(first, second);
+		swap(first_dist, second_dist);
+	}
+	collect_close_pairs(tree, first, first_dist, p, N, bound, heap);
+	collect_close_pairs(tree, second, second_dist, p, N, bound, heap);
+}
+
+// The N globally closest pairs, sorted by edge_less, without computing all
+// pairs. Pairs of points adjacent in tree order are real pairs, so the N-th
+// smallest of their distances bounds the answer from above; the k-d tree
+// search then only has to visit pairs within that radius, and the radius
+// shrinks to the current N-th best as the heap fills up.
+vector<Edge> closest_pairs(const vector<Point>& points, int N) {
+	int n = points.size();
+	if (n < 2 || N <= 0)
+		return {};
+
+	KdTree tree(points);
+	long long bound = numeric_limits<long long>::max();
+	if (n - 1 >= N) {
+		vector<long long> seed(n - 1);
+		for (int i = 0; i + 1 < n; ++i)
+			seed[i] = dist_sq(tree.pts[i], tree.pts[i + 1]);
+		nth_element(seed.begin(), seed.begin() + (N - 1), seed.end());
+		bound = seed[N - 1];
+	}
+
+	vector<Edge> heap;
+	heap.reserve(N);
+	for (int p = 0; p + 1 < n; ++p) {
+		collect_close_pairs(tree, 0, 0, p, N, bound, heap);
+	}
+	sort_heap(heap.begin(), heap.end(), edge_less);
+	return heap;
+}
+
+// Euclidean minimum spanning tree by Boruvka rounds over the k-d tree, in
+// O(n) memory. Ties are broken by edge_less, so this is the same tree Kruskal
+// builds from the sorted edge list.
+vector<Edge> euclidean_mst(const vector<Point>& points) {
+	int n = points.size();
+	vector<Edge> mst;
+	if (n < 2)
+		return mst;
+	mst.reserve(n - 1);
+
+	KdTree tree(points);
+	DSU dsu(n); // over input indices
+	vector<int> comp(n); // component root, by tree position
+	vector<int> node_comp(tree.nodes.size());
+	vector<Edge> best(n);
+
+	// Per-point cache across rounds, by tree position. The set of
+	// other-component points only shrinks, so a point's nearest one from an
+	// earlier round is still exact while it stays in another component, and a
+	// stale distance is still a lower bound that lets the point be skipped.
+	vector<int> nearest(n, -1);
+	vector<long long> lower_bound(n, 0);
+
+	while (dsu.num_components > 1) {
+		for (int i = 0; i < n; ++i)
+			comp[i] = dsu.find(tree.pts[i].id);
+		// Children come after their parent, so a reverse sweep is bottom-up.
+		for (int id = tree.nodes.size() - 1; id >= 0; --id) {
+			const KdTree::Node& node = tree.nodes[id];
+			if (node.left == -1) {
+				int c = comp[node.lo];
+				for (int i = node.lo + 1; i < node.hi && c != -1; ++i) {
+					if (comp[i] != c)
+						c = -1;
+				}
+				node_comp[id] = c;
+			}
+			else {
+				int c = node_comp[node.left];
+				node_comp[id] = (c == node_comp[node.right]) ? c : -1;
+			}
+		}
+
+		for (int i = 0; i < n; ++i)
+			best[i] = { -1, -1, 0 };
+		for (int p = 0; p < n; ++p) {
+			int c = comp[p];
+			Edge& comp_best = best[c];
+			if (nearest[p] != -1 && comp[nearest[p]] != c) {
+				int a = tree.pts[p].id, b = tree.pts[nearest[p]].id;
+				Edge candidate = { min(a, b), max(a, b), lower_bound[p] };
+				if (comp_best.u == -1 || edge_less(candidate, comp_best))
+					comp_best = candidate;
+				continue;
+			}
+			if (comp_best.u != -1 && lower_bound[p] > comp_best.distSq)
+				continue;
+
+			Edge found = comp_best;
+			int found_q = -1;
+			nearest_other_component(tree, 0, 0, p, comp, node_comp, found,
+				found_q);
+			if (found_q != -1) {
+				// Beat the component's bound, so it is p's exact nearest.
+				nearest[p] = found_q;
+				lower_bound[p] = found.distSq;
+				comp_best = found;
+			}
+			else {
+				nearest[p] = -1;
+				lower_bound[p] = max(lower_bound[p], comp_best.distSq);
+			}
+		}
+
+		for (int c = 0; c < n; ++c) {
+			if (best[c].u == -1)
+				continue;
+			if (dsu.unite(best[c].u, best[c].v))
+				mst.push_back(best[c]);
+		}
+	}
+	return mst;
+}
+
+// Part 2 via the EMST: the connection that finally joins everything into one
+// circuit is the largest MST edge, so no edge list is needed.
+long long solve_part2_emst(const vector<Point>& points) {
+	vector<Edge> mst = euclidean_mst(points);
+	if (mst.empty())
+		return 0;
+	Edge last = *max_element(mst.begin(), mst.end(), edge_less);
+	return (long long)points[last.u].x * points[last.v].x;
+}
+
+// Link-cut tree (Sleator-Tarjan) over point nodes and edge nodes. Every
+// splay subtree tracks its heaviest edge node under edge_less, so the
+// heaviest edge on the tree path between two points is an O(log n) query and
+// edges can be linked and cut as the spanning tree changes.
+struct LinkCutTree {
+	struct Node {
+		int child[2];
+		int parent;
+		bool flip;
+		Edge weight; // u == -1 for point nodes
+		int heaviest;
+	};
+
+	vector<Node> nodes;
+	vector<int> free_nodes;
+	vector<int> path; // scratch for splay
+
+	int add_node(Edge weight) {
+		int x;
+		if (!free_nodes.empty()) {
+			x = free_nodes.back();
+			free_nodes.pop_back();
+		}
+		else {
+			x = nodes.size();
+			nodes.emplace_back();
+		}
+		nodes[x] = { { -1, -1 }, -1, false, weight, x };
+		return x;
+	}
+
+	void release_node(int x) { free_nodes.push_back(x); }
+
+	bool heavier(int a, int b) const {
+		const Edge& ea = nodes[a].weight;
+		const Edge& eb = nodes[b].weight;
+		if (ea.u == -1)
+			return false;
+		if (eb.u == -1)
+			return true;
+		return edge_less(eb, ea);
+	}
+
+	bool is_splay_root(int x) const {
+		int p = nodes[x].parent;
+		return p == -1 || (nodes[p].child[0] != x && nodes[p].child[1] != x);
+	}
+
+	void push(int x) {
+		Node& node = nodes[x];
+		if (!node.flip)
+			return;
+		swap(node.child[0], node.child[1]);
+		for (int c : node.child) {
+			if (c != -1)
+				nodes[c].flip = !nodes[c].flip;
+		}
+		node.flip = false;
+	}
+
+	void pull(int x) {
+		int best = x;
+		for (int c : nodes[x].child) {
+			if (c != -1 && heavier(nodes[c].heaviest, best))
+				best = nodes[c].heaviest;
+		}
+		nodes[x].heaviest = best;
+	}
+
+	void rotate(int x) {
+		int p = nodes[x].parent;
+		int g = nodes[p].parent;
+		int dir = (nodes[p].child[1] == x);
+		int moved = nodes[x].child[dir ^ 1];
+		if (!is_splay_root(p)) {
+			if (nodes[g].child[0] == p)
+				nodes[g].child[0] = x;
+			else
+				nodes[g].child[1] = x;
+		}
+		nodes[x].parent = g;
+		nodes[x].child[dir ^ 1] = p;
+		nodes[p].parent = x;
+		nodes[p].child[dir] = moved;
+		if (moved != -1)
+			nodes[moved].parent = p;
+		pull(p);
+		pull(x);
+	}
+
+	void splay(int x) {
+		path.clear();
+		for (int y = x;; y = nodes[y].parent) {
+			path.push_back(y);
+			if (is_splay_root(y))
+				break;
+		}
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
+			push(*it);
+
+		while (!is_splay_root(x)) {
+			int p = nodes[x].parent;
+			if (!is_splay_root(p)) {
+				int g = nodes[p].parent;
+				bool zigzig = (nodes[g].child[0] == p) == (nodes[p].child[0] == x);
+				rotate(zigzig ? p : x);
+			}
+			rotate(x);
+		}
+	}
+
+	void access(int x) {
+		int last = -1;
+		for (int y = x; y != -1; y = nodes[y].parent) {
+			splay(y);
+			nodes[y].child[1] = last;
+			pull(y);
+			last = y;
+		}
+		splay(x);
+	}
+
+	void make_root(int x) {
+		access(x);
+		nodes[x].flip = !nodes[x].flip;
+	}
+
+	void link(int x, int y) {
+		make_root(x);
+		nodes[x].parent = y;
+	}
+
+	// x and y must be adjacent.
+	void cut(int x, int y) {
+		make_root(x);
+		access(y);
+		nodes[y].child[0] = -1;
+		nodes[x].parent = -1;
+		pull(y);
+	}
+
+	// Node of the heaviest edge on the path between x and y (connected).
+	int path_heaviest(int x, int y) {
+		make_root(x);
+		access(y);
+		return nodes[y].heaviest;
+	}
+};
+
+// Appends the input indices of all tree points within squared distance r2
+// of p.
+void points_within(const KdTree& tree, int node_id, const Point& p,
+	long long r2, vector<int>& out) {
+	const KdTree::Node& node = tree.nodes[node_id];
+	if (tree.box_dist_sq(node, p) > r2)
+		return;
+	if (node.left == -1) {
+		for (int i = node.lo; i < node.hi; ++i) {
+			if (dist_sq(p, tree.pts[i]) <= r2)
+				out.push_back(tree.pts[i].id);
+		}
+		return;
+	}
+	points_within(tree, node.left, p, r2, out);
+	points_within(tree, node.right, p, r2, out);
+}
+
+// Plain nearest neighbour of p among the tree points.
+void nearest_point(const KdTree& tree, int node_id, const Point& p,
+	long long& best_dist, int& best_id) {
+	const KdTree::Node& node = tree.nodes[node_id];
+	if (best_id != -1 && tree.box_dist_sq(node, p) > best_dist)
+		return;
+	if (node.left == -1) {
+		for (int i = node.lo; i < node.hi; ++i) {
+			long long d = dist_sq(p, tree.pts[i]);
+			if (best_id == -1 || d < best_dist ||
+				(d == best_dist && tree.pts[i].id < best_id)) {
+				best_dist = d;
+				best_id = tree.pts[i].id;
+			}
+		}
+		return;
+	}
+	int first = node.left, second = node.right;
+	if (tree.box_dist_sq(tree.nodes[second], p) <
+		tree.box_dist_sq(tree.nodes[first], p))
+		swap(first, second);
+	nearest_point(tree, first, p, best_dist, best_id);
+	nearest_point(tree, second, p, best_dist, best_id);
+}
+
+// Long-lived engine for junction boxes commissioned one at a time. It keeps
+// the current EMST in a link-cut tree, the N closest pairs in a bounded
+// max-heap, and a k-d tree over the points plus a small buffer of boxes added
+// since the tree was last rebuilt.
+//
+// Inserting p only needs p's edges: new MST = MST(old MST + edges of p). The
+// nearest one always attaches p; every further edge (in edge_less order)
+// closes a cycle and replaces the heaviest edge on it when lighter. An edge
+// longer than both p's nearest edge and the heaviest current MST edge would
+// be the heaviest on its own cycle, so only points within that radius are
+// examined. The same radius search, widened to the N-th closest pair, feeds
+// the closest-pairs heap.
+struct OnlineCircuits {
+	int N;
+	vector<Point> points;
+	vector<int> point_node; // link-cut tree node of each point
+	LinkCutTree lct;
+	set<Edge, bool (*)(const Edge&, const Edge&)> mst_edges{ edge_less };
+	vector<Edge> closest; // max-heap under edge_less, at most N edges
+
+	unique_ptr<KdTree> tree; // covers points[0, indexed)
+	int indexed = 0;
+
+	OnlineCircuits(const vector<Point>& initial, int budget) : N(budget) {
+		points = initial;
+		for (int i = 0; i < (int)points.size(); ++i) {
+			points[i].id = i;
+			point_node.push_back(lct.add_node({ -1, -1, 0 }));
+		}
+		for (const Edge& e : euclidean_mst(points))
+			add_mst_edge(e);
+		closest = closest_pairs(points, N);
+		make_heap(closest.begin(), closest.end(), edge_less);
+		rebuild_index();
+	}
+
+	void rebuild_index() {
+		tree.reset(points.empty() ? nullptr : new KdTree(points));
+		indexed = points.size();
+	}
+
+	void add_mst_edge(const Edge& e) {
+		int node = lct.add_node(e);
+		lct.link(point_node[e.u], node);
+		lct.link(node, point_node[e.v]);
+		mst_edges.insert(e);
+	}
+
+	void remove_mst_edge(int node) {
+		Edge e = lct.nodes[node].weight;
+		lct.cut(point_node[e.u], node);
+		lct.cut(node, point_node[e.v]);
+		lct.release_node(node);
+		mst_edges.erase(e);
+	}
+
+	void insert(Point p) {
+		int id = points.size();
+		p.id = id;
+		point_node.push_back(lct.add_node({ -1, -1, 0 }));
+
+		if (id > 0) {
+			long long nearest_dist = 0;
+			int nearest_id = -1;
+			if (tree)
+				nearest_point(*tree, 0, p, nearest_dist, nearest_id);
+			for (int q = indexed; q < id; ++q) {
+				long long d = dist_sq(p, points[q]);
+				if (nearest_id == -1 || d < nearest_dist) {
+					nearest_dist = d;
+					nearest_id = q;
+				}
+			}
+
+			long long mst_radius = nearest_dist;
+			if (!mst_edges.empty())
+				mst_radius = max(mst_radius, mst_edges.rbegin()->distSq);
+			long long pair_radius = ((int)closest.size() == N)
+				? closest.front().distSq
+				: numeric_limits<long long>::max();
+
+			vector<int> near;
+			long long radius = max(mst_radius, pair_radius);
+			if (tree)
+				points_within(*tree, 0, p, radius, near);
+			for (int q = indexed; q < id; ++q) {
+				if (dist_sq(p, points[q]) <= radius)
+					near.push_back(q);
+			}
+
+			vector<Edge> candidates;
+			for (int q : near)
+				candidates.push_back({ q, id, dist_sq(p, points[q]) });
+			sort(candidates.begin(), candidates.end(), edge_less);
+
+			for (const Edge& e : candidates) {
+				if (N <= 0)
+					break;
+				if ((int)closest.size() < N) {
+					closest.push_back(e);
+					push_heap(closest.begin(), closest.end(), edge_less);
+				}
+				else if (edge_less(e, closest.front())) {
+					pop_heap(closest.begin(), closest.end(), edge_less);
+					closest.back() = e;
+					push_heap(closest.begin(), closest.end(), edge_less);
+				}
+				else {
+					break;
+				}
+			}
+
+			points.push_back(p);
+			bool attached = false;
+			for (const Edge& e : candidates) {
+				if (e.distSq > mst_radius)
+					break;
+				if (!attached) {
+					add_mst_edge(e);
+					attached = true;
+					continue;
+				}
+				int heaviest = lct.path_heaviest(point_node[e.u], point_node[e.v]);
+				if (edge_less(e, lct.nodes[heaviest].weight)) {
+					remove_mst_edge(heaviest);
+					add_mst_edge(e);
+				}
+			}
+		}
+		else {
+			points.push_back(p);
+		}
+
+		int buffered = points.size() - indexed;
+		if (buffered > max(64, 4 * (int)sqrt((double)points.size())))
+			rebuild_index();
+	}
+
+	long long part1() const {
+		vector<Edge> sorted = closest;
+		sort(sorted.begin(), sorted.end(), edge_less);
+		return solve_part1(N, sorted, points.size());
+	}
+
+	long long part2() const {
+		if (mst_edges.empty())
+			return 0;
+		const Edge& last = *mst_edges.rbegin();
+		return (long long)points[last.u].x * points[last.v].x;
+	}
+};
+
+template <class EdgeList>
+int write_curve_file(const string& path, const EdgeList& edges,
+	int num_points) {
+	ofstream out(path);
+	if (!out) {
+		cerr << "Error opening curve file: " << path << endl;
+		return 1;
+	}
+	size_t rows = write_circuit_curve(edges, num_points, out);
+	cout << rows << " curve rows written to " << path << endl;
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
 	string filename = "input.txt";
 	int N = 1000;
+	bool has_file = false;
+	bool emst = false;
+	bool closest = false;
+	string curve_path;
+	bool bench = false;
+	bool online = false;
+	int num_threads = max(1u, thread::hardware_concurrency());
 
-	if (argc > 1) {
-		filename = argv[1];
-	}
-	if (argc > 2) {
-		try {
-			N = stoi(argv[2]);
+	int positional = 0;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--emst") {
+			emst = true;
+		}
+		else if (arg == "--closest") {
+			closest = true;
+		}
+		else if (arg == "--curve" && i + 1 < argc) {
+			curve_path = argv[++i];
+		}
+		else if (arg == "--bench") {
+			bench = true;
+		}
+		else if (arg == "--online") {
+			online = true;
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			num_threads = max(1, stoi(argv[++i]));
 		}
-		catch (...) {
-			// Ignore if not a number (could be pipe issue or just no arg)
+		else if (positional == 0) {
+			// "-" keeps stdin, so N can still be given.
+			filename = arg;
+			has_file = (arg != "-");
+			positional++;
+		}
+		else if (positional == 1) {
+			try {
+				N = stoi(arg);
+			}
+			catch (...) {
+				// Ignore if not a number (could be pipe issue or just no arg)
+			}
+			positional++;
 		}
 	}
 
 	ifstream infile(filename);
 	istream* input = &cin;
-	if (filename != "input.txt" || argc > 1) {
+	if (has_file) {
 		if (!infile) {
 			cerr << "Error opening file: " << filename << endl;
 			return 1;
@@ -150,7 +1293,9 @@ int main(int argc, char* argv[]) {
 	vector<Point> points;
 	string line;
 	int id_counter = 0;
-	while (getline(*input, line)) {
+	// In online mode stdin carries the commands, so initial boxes come only
+	// from a file.
+	while ((has_file || !online) && getline(*input, line)) {
 		if (line.empty())
 			continue;
 		stringstream ss(line);
@@ -164,18 +1309,95 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	vector<Edge> edges;
-	for (int i = 0; i < points.size(); ++i) {
-		for (int j = i + 1; j < points.size(); ++j) {
-			long long dx = points[i].x - points[j].x;
-			long long dy = points[i].y - points[j].y;
-			long long dz = points[i].z - points[j].z;
-			long long distSq = dx * dx + dy * dy + dz * dz;
-			edges.push_back({ i, j, distSq });
+	if (online) {
+		// One command per line: "x,y,z" commissions a box, "1" / "2" print
+		// the current answers.
+		OnlineCircuits engine(points, N);
+		while (getline(cin, line)) {
+			if (line.empty())
+				continue;
+			if (line == "1") {
+				cout << "Part 1: " << engine.part1() << endl;
+				continue;
+			}
+			if (line == "2") {
+				cout << "Part 2: " << engine.part2() << endl;
+				continue;
+			}
+			stringstream ss(line);
+			string segment;
+			vector<int> coords;
+			while (getline(ss, segment, ',')) {
+				coords.push_back(stoi(segment));
+			}
+			if (coords.size() == 3)
+				engine.insert({ coords[0], coords[1], coords[2], 0 });
+			else
+				cerr << "Ignoring command: " << line << endl;
 		}
+		return 0;
 	}
 
-	sort(edges.begin(), edges.end(), compareEdges);
+	if (bench) {
+		// Edge generation only: the original loop against the tiled generator.
+		auto t0 = chrono::steady_clock::now();
+		vector<Edge> serial = build_all_edges_serial(points);
+		auto t1 = chrono::steady_clock::now();
+		vector<Edge> tiled = build_all_edges(points, num_threads);
+		auto t2 = chrono::steady_clock::now();
+		bool same = serial.size() == tiled.size();
+		for (size_t k = 0; same && k < serial.size(); ++k) {
+			same = serial[k].u == tiled[k].u && serial[k].v == tiled[k].v &&
+				serial[k].distSq == tiled[k].distSq;
+		}
+		cout << serial.size() << " edges" << endl;
+		cout << "serial: "
+			<< chrono::duration<double, milli>(t1 - t0).count() << " ms" << endl;
+		cout << "tiled (" << num_threads << " threads): "
+			<< chrono::duration<double, milli>(t2 - t1).count() << " ms"
+			<< (same ? "" : " MISMATCH") << endl;
+
+		// Sorting: 16-byte edges with std::sort against packed keys with the
+		// radix sort.
+		auto t3 = chrono::steady_clock::now();
+		sort(serial.begin(), serial.end(), compareEdges);
+		auto t4 = chrono::steady_clock::now();
+		cout << "std::sort: " << chrono::duration<double, milli>(t4 - t3).count()
+			<< " ms, " << serial.size() * sizeof(Edge) << " bytes" << endl;
+		serial.clear();
+		serial.shrink_to_fit();
+		tiled.clear();
+		tiled.shrink_to_fit();
+
+		PackedEdges packed(points);
+		if (packed.fits()) {
+			packed.build(points, num_threads);
+			auto t5 = chrono::steady_clock::now();
+			radix_sort_keys(packed.keys, packed.pair_bits, packed.key_bits,
+				num_threads);
+			auto t6 = chrono::steady_clock::now();
+			cout << "radix (" << packed.key_bits << "-bit keys): "
+				<< chrono::duration<double, milli>(t6 - t5).count() << " ms, "
+				<< packed.size() * sizeof(unsigned long long) << " bytes" << endl;
+
+			// Part 2: Kruskal over the sorted keys against filter-Kruskal on
+			// freshly generated (unsorted) keys.
+			long long sorted_result = solve_part2(packed, points.size(), points);
+			auto t7 = chrono::steady_clock::now();
+			packed.build(points, num_threads);
+			auto t8 = chrono::steady_clock::now();
+			long long filtered_result =
+				solve_part2_filter_kruskal(packed, points, num_threads);
+			auto t9 = chrono::steady_clock::now();
+			cout << "part 2 sort + scan: "
+				<< chrono::duration<double, milli>(t7 - t5).count() << " ms"
+				<< endl;
+			cout << "part 2 filter-Kruskal: "
+				<< chrono::duration<double, milli>(t9 - t8).count() << " ms"
+				<< (sorted_result == filtered_result ? "" : " MISMATCH") << endl;
+		}
+		return 0;
+	}
 
 	if (input == &cin)
 		cin.clear();
@@ -186,16 +1408,48 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
-	if (part == 1) {
-		cout << solve_part1(N, edges, points.size()) << endl;
+	if (part == 1 && closest) {
+		cout << solve_part1(N, closest_pairs(points, N), points.size()) << endl;
+		return 0;
 	}
-	else if (part == 2) {
-		cout << solve_part2(edges, points.size(), points) << endl;
+	if (part == 2 && emst) {
+		cout << solve_part2_emst(points) << endl;
+		return 0;
 	}
-	else {
+
+	if (part != 1 && part != 2) {
 		cerr << "Invalid part selected." << endl;
 		return 1;
 	}
 
+	PackedEdges packed(points);
+	if (packed.fits()) {
+		packed.build(points, num_threads);
+		if (part == 1) {
+			radix_sort_keys(packed.keys, packed.pair_bits, packed.key_bits,
+				num_threads);
+			if (!curve_path.empty())
+				return write_curve_file(curve_path, packed, points.size());
+			cout << solve_part1(N, packed, points.size()) << endl;
+		}
+		else {
+			cout << solve_part2_filter_kruskal(packed, points, num_threads)
+				<< endl;
+		}
+		return 0;
+	}
+
+	vector<Edge> edges = build_all_edges(points, num_threads);
+	sort(edges.begin(), edges.end(), edge_less);
+
+	if (part == 1) {
+		if (!curve_path.empty())
+			return write_curve_file(curve_path, edges, points.size());
+		cout << solve_part1(N, edges, points.size()) << endl;
+	}
+	else {
+		cout << solve_part2(edges, points.size(), points) << endl;
+	}
+
 	return 0;
 }
@@ -1,9 +1,15 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <queue>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 
@@ -88,23 +94,457 @@ bool edge_crosses_rect_boundary(Point u, Point v, long long min_x,
 	return false;
 }
 
-long long solve_part1(const vector<Point>& points) {
-	long long max_area = 0;
-	for (size_t i = 0; i < points.size(); ++i) {
-		for (size_t j = i + 1; j < points.size(); ++j) {
-			long long width = abs(points[i].x - points[j].x) + 1;
-			long long height = abs(points[i].y - points[j].y) + 1;
-			long long area = width * height;
-			if (area > max_area) {
-				max_area = area;
+// Runs f(t) for t in [0, num_threads), on num_threads - 1 extra threads plus
+// the calling one.
+template <class F> void run_threads(int num_threads, F f) {
+	vector<thread> threads;
+	for (int t = 1; t < num_threads; ++t)
+		threads.emplace_back(f, t);
+	f(0);
+	for (thread& t : threads)
+		t.join();
+}
+
+// Splits the rows of the pair triangle (row i holds pairs (i, j > i)) into
+// blocks of roughly equal pair counts and hands them to the threads from an
+// atomic counter, as f(first_row, end_row). Several blocks per thread keep
+// the threads busy when validation cost varies between blocks.
+template <class F> void for_each_pair_block(int n, int num_threads, F f) {
+	if (num_threads <= 1 || n < 64) {
+		f(0, n);
+		return;
+	}
+	long long total = (long long)n * (n - 1) / 2;
+	int num_blocks = num_threads * 8;
+	vector<int> starts = { 0 };
+	long long done = 0;
+	for (int i = 0; i < n; ++i) {
+		done += n - 1 - i;
+		if (done * num_blocks >= total * (long long)starts.size() &&
+			(int)starts.size() < num_blocks)
+			starts.push_back(i + 1);
+	}
+	if (starts.back() != n)
+		starts.push_back(n);
+
+	atomic<int> next_block(0);
+	run_threads(num_threads, [&](int) {
+		for (;;) {
+			int b = next_block.fetch_add(1);
+			if (b + 1 >= (int)starts.size())
+				break;
+			f(starts[b], starts[b + 1]);
+		}
+	});
+}
+
+// Raises best to value; the result only depends on the values offered, so the
+// answer is the same whatever the thread interleaving.
+void update_max(atomic<long long>& best, long long value) {
+	long long seen = best.load(memory_order_relaxed);
+	while (value > seen &&
+		!best.compare_exchange_weak(seen, value, memory_order_relaxed)) {
+	}
+}
+
+// The red tiles joined in order form a rectilinear polygon through tile
+// centres, and a tile is red or green exactly when its centre lies in the
+// closed polygon. Between consecutive distinct vertex coordinates that
+// membership cannot change, so the plane is compressed to a grid whose odd
+// rows/columns stand for the gaps between vertex coordinates. Each cell is
+// classified once with integer tests and a 2D prefix sum counts the cells
+// outside the polygon, so "is this rectangle all red/green" is O(1).
+struct CompressedGrid {
+	vector<long long> xs, ys; // distinct vertex coordinates
+	int w = 0, h = 0; // 2 * distinct - 1
+	vector<unsigned> outside; // (w + 1) x (h + 1) prefix sums
+	bool rectilinear = true;
+
+	CompressedGrid(const vector<Point>& poly, int num_threads = 1) {
+		int n = poly.size();
+		for (const auto& p : poly) {
+			xs.push_back(p.x);
+			ys.push_back(p.y);
+		}
+		sort(xs.begin(), xs.end());
+		xs.erase(unique(xs.begin(), xs.end()), xs.end());
+		sort(ys.begin(), ys.end());
+		ys.erase(unique(ys.begin(), ys.end()), ys.end());
+		if (n == 0)
+			return;
+		w = 2 * xs.size() - 1;
+		h = 2 * ys.size() - 1;
+
+		// Vertical edges as (column, lower row, upper row); horizontal edges
+		// bucketed by row as (left column, right column).
+		struct VEdge {
+			int col, lo, hi;
+		};
+		vector<VEdge> vertical;
+		vector<vector<pair<int, int>>> horizontal(h);
+		for (int i = 0; i < n; ++i) {
+			Point a = poly[i], b = poly[(i + 1) % n];
+			if (a.x == b.x) {
+				int lo = y_index(min(a.y, b.y)), hi = y_index(max(a.y, b.y));
+				vertical.push_back({ x_index(a.x), lo, hi });
+			}
+			else if (a.y == b.y) {
+				horizontal[y_index(a.y)].push_back(
+					{ x_index(min(a.x, b.x)), x_index(max(a.x, b.x)) });
 			}
+			else {
+				rectilinear = false;
+				return;
+			}
+		}
+
+		// Classify rows independently (in parallel): a cell's row is inside
+		// when an odd number of vertical edges cross it further right
+		// (half-open in y so vertices count once); cells on an edge are
+		// always in. Each row first holds its own running count; the column
+		// sums are added afterwards.
+		outside.assign((size_t)(w + 1) * (h + 1), 0);
+		atomic<int> next_row(0);
+		run_threads(num_threads, [&](int) {
+			vector<unsigned char> crossings(w), boundary(w), out_cell(w);
+			for (;;) {
+				int r = next_row.fetch_add(1);
+				if (r >= h)
+					break;
+				fill(crossings.begin(), crossings.end(), 0);
+				fill(boundary.begin(), boundary.end(), 0);
+				bool empty_gap = (r % 2 == 1 && ys[r / 2] + 1 == ys[r / 2 + 1]);
+				if (!empty_gap) {
+					for (const auto& e : vertical) {
+						if (e.lo <= r && r <= e.hi)
+							boundary[e.col] = 1;
+						if (e.lo <= r && r < e.hi)
+							crossings[e.col] ^= 1;
+					}
+					for (const auto& e : horizontal[r]) {
+						for (int c = e.first; c <= e.second; ++c)
+							boundary[c] = 1;
+					}
+				}
+
+				bool parity = false; // crossings strictly right of column c
+				for (int c = w - 1; c >= 0; --c) {
+					bool empty_cell = empty_gap ||
+						(c % 2 == 1 && xs[c / 2] + 1 == xs[c / 2 + 1]);
+					out_cell[c] = !empty_cell && !boundary[c] && !parity;
+					parity ^= crossings[c];
+				}
+				unsigned* row = &outside[(size_t)(r + 1) * (w + 1)];
+				unsigned run = 0;
+				for (int c = 0; c < w; ++c) {
+					run += out_cell[c];
+					row[c + 1] = run;
+				}
+			}
+		});
+		for (int r = 1; r <= h; ++r) {
+			unsigned* row = &outside[(size_t)r * (w + 1)];
+			const unsigned* above = row - (w + 1);
+			for (int c = 1; c <= w; ++c)
+				row[c] += above[c];
 		}
 	}
-	return max_area;
+
+	int x_index(long long x) const {
+		return 2 * (lower_bound(xs.begin(), xs.end(), x) - xs.begin());
+	}
+
+	int y_index(long long y) const {
+		return 2 * (lower_bound(ys.begin(), ys.end(), y) - ys.begin());
+	}
+
+	// Number of outside cells in columns [c1, c2] x rows [r1, r2].
+	unsigned count_outside(int c1, int c2, int r1, int r2) const {
+		size_t stride = w + 1;
+		return outside[(r2 + 1) * stride + c2 + 1] -
+			outside[r1 * stride + c2 + 1] - outside[(r2 + 1) * stride + c1] +
+			outside[r1 * stride + c1];
+	}
+};
+
+// Segment tree over leaf positions whose nodes hold sorted values. A value
+// is either added over a leaf range (stored in the O(log n) canonical nodes,
+// found again by walking up from a leaf) or at one leaf (stored in every
+// ancestor, found again through a range's canonical nodes). Queries cost
+// O(log^2 n).
+struct SortedSegmentTree {
+	int size = 0;
+	vector<vector<long long>> nodes;
+
+	void init(int leaves) {
+		size = max(1, leaves);
+		nodes.assign(2 * size, {});
+	}
+
+	void add_range(int l, int r, long long value) { // leaves [l, r]
+		for (l += size, r += size + 1; l < r; l >>= 1, r >>= 1) {
+			if (l & 1)
+				nodes[l++].push_back(value);
+			if (r & 1)
+				nodes[--r].push_back(value);
+		}
+	}
+
+	void add_point(int leaf, long long value) {
+		for (int i = leaf + size; i >= 1; i >>= 1)
+			nodes[i].push_back(value);
+	}
+
+	void build() {
+		for (auto& node : nodes)
+			sort(node.begin(), node.end());
+	}
+
+	static bool any_between(const vector<long long>& v, long long lo,
+		long long hi) { // strictly inside (lo, hi)
+		auto it = upper_bound(v.begin(), v.end(), lo);
+		return it != v.end() && *it < hi;
+	}
+
+	// Any range value covering leaf that lies strictly in (lo, hi)?
+	bool stab_any(int leaf, long long lo, long long hi) const {
+		for (int i = leaf + size; i >= 1; i >>= 1) {
+			if (any_between(nodes[i], lo, hi))
+				return true;
+		}
+		return false;
+	}
+
+	// Number of range values covering leaf that are greater than v.
+	long long stab_count_greater(int leaf, long long v) const {
+		long long count = 0;
+		for (int i = leaf + size; i >= 1; i >>= 1)
+			count += nodes[i].end() - upper_bound(nodes[i].begin(), nodes[i].end(), v);
+		return count;
+	}
+
+	// Any point value at leaves [l, r] that lies strictly in (lo, hi)?
+	bool range_any(int l, int r, long long lo, long long hi) const {
+		for (l += size, r += size + 1; l < r; l >>= 1, r >>= 1) {
+			if ((l & 1) && any_between(nodes[l++], lo, hi))
+				return true;
+			if ((r & 1) && any_between(nodes[--r], lo, hi))
+				return true;
+		}
+		return false;
+	}
+};
+
+// Edge and vertex index for the ray-cast validator on rectilinear polygons.
+// Leaves follow the compressed-grid layout: 2r is the r-th distinct vertex
+// coordinate, 2r + 1 the open gap after it. Each query below replaces an O(n)
+// scan with O(log^2 n) work and gives exactly the same answer.
+struct EdgeIndex {
+	vector<long long> xs, ys;
+	SortedSegmentTree vertical_cross; // x of vertical edges, over open y span
+	SortedSegmentTree vertical_ray; // x of vertical edges, over [ylo, yhi)
+	SortedSegmentTree horizontal_cross; // y of horizontal edges, over open x span
+	SortedSegmentTree vertices; // y of each vertex, at its x
+	bool rectilinear = true;
+
+	EdgeIndex(const vector<Point>& poly) {
+		int n = poly.size();
+		for (const auto& p : poly) {
+			xs.push_back(p.x);
+			ys.push_back(p.y);
+		}
+		sort(xs.begin(), xs.end());
+		xs.erase(unique(xs.begin(), xs.end()), xs.end());
+		sort(ys.begin(), ys.end());
+		ys.erase(unique(ys.begin(), ys.end()), ys.end());
+		int w = max(1, 2 * (int)xs.size() - 1);
+		int h = max(1, 2 * (int)ys.size() - 1);
+		vertical_cross.init(h);
+		vertical_ray.init(h);
+		horizontal_cross.init(w);
+		vertices.init(w);
+
+		for (int i = 0; i < n; ++i) {
+			Point a = poly[i], b = poly[(i + 1) % n];
+			vertices.add_point(x_leaf(a.x), a.y);
+			if (a.x == b.x) {
+				int lo = y_leaf(min(a.y, b.y)), hi = y_leaf(max(a.y, b.y));
+				if (lo < hi) {
+					vertical_cross.add_range(lo + 1, hi - 1, a.x);
+					vertical_ray.add_range(lo, hi - 1, a.x);
+				}
+			}
+			else if (a.y == b.y) {
+				int lo = x_leaf(min(a.x, b.x)), hi = x_leaf(max(a.x, b.x));
+				horizontal_cross.add_range(lo + 1, hi - 1, a.y);
+			}
+			else {
+				rectilinear = false;
+			}
+		}
+		vertical_cross.build();
+		vertical_ray.build();
+		horizontal_cross.build();
+		vertices.build();
+	}
+
+	// Leaf of a vertex coordinate.
+	int x_leaf(long long x) const {
+		return 2 * (lower_bound(xs.begin(), xs.end(), x) - xs.begin());
+	}
+
+	int y_leaf(long long y) const {
+		return 2 * (lower_bound(ys.begin(), ys.end(), y) - ys.begin());
+	}
+
+	// Leaf of the y coordinate twice_y / 2, or -1 outside every edge.
+	int half_y_leaf(long long twice_y) const {
+		auto it = lower_bound(ys.begin(), ys.end(), twice_y,
+			[](long long v, long long t) { return 2 * v < t; });
+		int r = it - ys.begin();
+		if (it != ys.end() && 2 * *it == twice_y)
+			return 2 * r;
+		if (r == 0 || it == ys.end())
+			return -1;
+		return 2 * r - 1;
+	}
+
+	// is_point_in_rect_strict for every vertex.
+	bool vertex_inside(long long min_x, long long max_x, long long min_y,
+		long long max_y) const {
+		int l = x_leaf(min_x) + 1, r = x_leaf(max_x) - 1;
+		return l <= r && vertices.range_any(l, r, min_y, max_y);
+	}
+
+	// edge_crosses_rect_boundary for every edge: only a perpendicular edge
+	// can cross a side strictly, passing through its open span.
+	bool edge_crosses(long long min_x, long long max_x, long long min_y,
+		long long max_y) const {
+		return vertical_cross.stab_any(y_leaf(min_y), min_x, max_x) ||
+			vertical_cross.stab_any(y_leaf(max_y), min_x, max_x) ||
+			horizontal_cross.stab_any(x_leaf(min_x), min_y, max_y) ||
+			horizontal_cross.stab_any(x_leaf(max_x), min_y, max_y);
+	}
+
+	// is_point_in_polygon at the rectangle centre: only vertical edges flip
+	// the leftward ray's parity, those with ylo <= cy < yhi and x > cx.
+	bool centre_inside(long long min_x, long long max_x, long long min_y,
+		long long max_y) const {
+		int leaf = half_y_leaf(min_y + max_y);
+		if (leaf < 0)
+			return false;
+		long long sum_x = min_x + max_x; // x > sum_x / 2
+		long long threshold = sum_x >= 0 ? sum_x / 2 : -((-sum_x + 1) / 2);
+		return vertical_ray.stab_count_greater(leaf, threshold) % 2 == 1;
+	}
+};
+
+long long solve_part1(const vector<Point>& points, int num_threads = 1) {
+	int n = points.size();
+	atomic<long long> max_area(0);
+	for_each_pair_block(n, num_threads, [&](int i0, int i1) {
+		long long local = 0;
+		for (int i = i0; i < i1; ++i) {
+			for (int j = i + 1; j < n; ++j) {
+				long long width = abs(points[i].x - points[j].x) + 1;
+				long long height = abs(points[i].y - points[j].y) + 1;
+				local = max(local, width * height);
+			}
+		}
+		update_max(max_area, local);
+	});
+	return max_area.load();
+}
+
+// Staircase (Pareto) frontier of the points no other point beats towards the
+// lower left, in x ascending / y descending order.
+vector<Point> lower_left_frontier(vector<Point> pts) {
+	sort(pts.begin(), pts.end(), [](const Point& a, const Point& b) {
+		return a.x != b.x ? a.x < b.x : a.y < b.y;
+	});
+	vector<Point> frontier;
+	for (const auto& p : pts) {
+		if (frontier.empty() || p.y < frontier.back().y)
+			frontier.push_back(p);
+	}
+	return frontier;
+}
+
+// Same towards the upper right, also returned x ascending / y descending.
+vector<Point> upper_right_frontier(vector<Point> pts) {
+	sort(pts.begin(), pts.end(), [](const Point& a, const Point& b) {
+		return a.x != b.x ? a.x > b.x : a.y > b.y;
+	});
+	vector<Point> frontier;
+	for (const auto& p : pts) {
+		if (frontier.empty() || p.y > frontier.back().y)
+			frontier.push_back(p);
+	}
+	reverse(frontier.begin(), frontier.end());
+	return frontier;
+}
+
+// Area of the rectangle with lower-left corner a and upper-right corner b.
+// When b lies below and left of a both factors are negative; the product is
+// negated so such pairs never win and the best column stays monotone.
+long long corner_area(const Point& a, const Point& b) {
+	long long width = b.x - a.x + 1;
+	long long height = b.y - a.y + 1;
+	if (width <= 0 && height <= 0)
+		return -width * height;
+	return width * height;
+}
+
+// For lower-left corners sorted along their staircase, the best upper-right
+// corner moves monotonically along its own staircase, so divide and conquer
+// over the rows needs O((m + k) log m) area evaluations.
+long long best_corner_pair(const vector<Point>& lows, const vector<Point>& highs,
+	int row_lo, int row_hi, int col_lo, int col_hi) {
+	if (row_lo > row_hi)
+		return numeric_limits<long long>::min();
+	int mid = (row_lo + row_hi) / 2;
+	int best_col = col_lo;
+	long long best = corner_area(lows[mid], highs[col_lo]);
+	for (int j = col_lo + 1; j <= col_hi; ++j) {
+		long long area = corner_area(lows[mid], highs[j]);
+		if (area > best) {
+			best = area;
+			best_col = j;
+		}
+	}
+	best = max(best, best_corner_pair(lows, highs, row_lo, mid - 1, col_lo,
+		best_col));
+	best = max(best, best_corner_pair(lows, highs, mid + 1, row_hi, best_col,
+		col_hi));
+	return best;
+}
+
+// Part 1 in O(n log n). Some optimal rectangle joins a lower-left frontier
+// point to an upper-right one, or (with y mirrored) an upper-left to a
+// lower-right one: moving a corner outwards never shrinks the area.
+long long solve_part1_frontier(const vector<Point>& points) {
+	if (points.size() < 2)
+		return 0;
+	long long best = 0;
+	vector<Point> pts = points;
+	for (int pass = 0; pass < 2; ++pass) {
+		vector<Point> lows = lower_left_frontier(pts);
+		vector<Point> highs = upper_right_frontier(pts);
+		best = max(best, best_corner_pair(lows, highs, 0, lows.size() - 1, 0,
+			highs.size() - 1));
+		for (auto& p : pts)
+			p.y = -p.y;
+	}
+	return best;
 }
 
-long long solve_part2(const vector<Point>& points) {
+// Original validation: centre ray cast plus O(n) vertex and edge scans per
+// candidate. The centre test misjudges rectangles whose centre lies on the
+// boundary; kept behind --raycast for comparison. On rectilinear polygons the
+// scans go through an EdgeIndex instead, with the same results.
+long long solve_part2_raycast(const vector<Point>& points) {
 	long long max_area = 0;
+	EdgeIndex index(points);
 
 	for (size_t i = 0; i < points.size(); ++i) {
 		for (size_t j = i + 1; j < points.size(); ++j) {
@@ -123,6 +563,14 @@ long long solve_part2(const vector<Point>& points) {
 			if (area <= max_area)
 				continue;
 
+			if (index.rectilinear) {
+				if (!index.vertex_inside(min_x, max_x, min_y, max_y) &&
+					!index.edge_crosses(min_x, max_x, min_y, max_y) &&
+					index.centre_inside(min_x, max_x, min_y, max_y))
+					max_area = area;
+				continue;
+			}
+
 			// Validation
 			// 1. Center inside
 			double cx = (min_x + max_x) / 2.0;
@@ -159,15 +607,240 @@ long long solve_part2(const vector<Point>& points) {
 	return max_area;
 }
 
+// O(n^2) pairs, each checked in O(1) against the compressed grid. Threads
+// share the best area found so far, so every one of them skips pairs that
+// cannot beat it.
+long long scan_pairs(const vector<Point>& points, const CompressedGrid& grid,
+	const vector<int>& col, const vector<int>& row, int num_threads) {
+	int n = points.size();
+	atomic<long long> max_area(0);
+	for_each_pair_block(n, num_threads, [&](int i0, int i1) {
+		for (int i = i0; i < i1; ++i) {
+			for (int j = i + 1; j < n; ++j) {
+				long long width = abs(points[i].x - points[j].x) + 1;
+				long long height = abs(points[i].y - points[j].y) + 1;
+				long long area = width * height;
+				if (area <= max_area.load(memory_order_relaxed))
+					continue;
+				if (grid.count_outside(min(col[i], col[j]), max(col[i], col[j]),
+					min(row[i], row[j]), max(row[i], row[j])) == 0)
+					update_max(max_area, area);
+			}
+		}
+	});
+	return max_area.load();
+}
+
+long long solve_part2_scan(const vector<Point>& points, int num_threads = 1) {
+	CompressedGrid grid(points, num_threads);
+	if (!grid.rectilinear) {
+		cerr << "Polygon is not rectilinear, falling back to ray casting."
+			<< endl;
+		return solve_part2_raycast(points);
+	}
+
+	// Grid indices of every vertex, so the pair loop does no searching.
+	size_t n = points.size();
+	vector<int> col(n), row(n);
+	for (size_t i = 0; i < n; ++i) {
+		col[i] = grid.x_index(points[i].x);
+		row[i] = grid.y_index(points[i].y);
+	}
+	return scan_pairs(points, grid, col, row, num_threads);
+}
+
+// Part 2 in descending area order: the first pair that passes the grid check
+// is the answer. Vertices go into a kd-tree, and a max-heap holds pairs of
+// tree nodes keyed by an upper bound on the area of any pair between them,
+// taken from the two bounding boxes. Popping a node pair splits its larger
+// node; once both sides are small, their pairs go into the heap with exact
+// areas. Only node pairs whose bound beats the answer are ever opened, so on
+// polygons with a fat answer little of the n^2 pairs is touched.
+//
+// When the answer is a thin sliver most pairs outrank it and would all be
+// validated through the heap, which is slower than the plain scan. After a
+// budget of validations the search gives up and runs the scan instead, so
+// the worst case is the scan plus that budget.
+struct SearchStats {
+	long long node_pairs_split = 0;
+	long long candidates_validated = 0;
+	bool fell_back_to_scan = false;
+};
+
+struct KdNode {
+	long long min_x, max_x, min_y, max_y;
+	int first, last; // range in the permuted vertex order
+	int left = -1, right = -1;
+};
+
+// Builds the tree over order[first, last) and returns its node index.
+int build_kd(const vector<Point>& points, vector<int>& order, int first,
+	int last, bool split_x, vector<KdNode>& nodes) {
+	const int LEAF_SIZE = 16;
+	KdNode node;
+	node.first = first;
+	node.last = last;
+	node.min_x = node.min_y = numeric_limits<long long>::max();
+	node.max_x = node.max_y = numeric_limits<long long>::min();
+	for (int k = first; k < last; ++k) {
+		const Point& p = points[order[k]];
+		node.min_x = min(node.min_x, p.x);
+		node.max_x = max(node.max_x, p.x);
+		node.min_y = min(node.min_y, p.y);
+		node.max_y = max(node.max_y, p.y);
+	}
+	int id = nodes.size();
+	nodes.push_back(node);
+	if (last - first > LEAF_SIZE) {
+		int mid = first + (last - first) / 2;
+		nth_element(order.begin() + first, order.begin() + mid,
+			order.begin() + last, [&](int a, int b) {
+				return split_x ? points[a].x < points[b].x : points[a].y < points[b].y;
+			});
+		int left = build_kd(points, order, first, mid, !split_x, nodes);
+		int right = build_kd(points, order, mid, last, !split_x, nodes);
+		nodes[id].left = left;
+		nodes[id].right = right;
+	}
+	return id;
+}
+
+long long solve_part2(const vector<Point>& points, SearchStats* stats = nullptr,
+	int num_threads = 1) {
+	CompressedGrid grid(points, num_threads);
+	if (!grid.rectilinear) {
+		cerr << "Polygon is not rectilinear, falling back to ray casting."
+			<< endl;
+		return solve_part2_raycast(points);
+	}
+
+	int n = points.size();
+	vector<int> col(n), row(n);
+	for (int i = 0; i < n; ++i) {
+		col[i] = grid.x_index(points[i].x);
+		row[i] = grid.y_index(points[i].y);
+	}
+	SearchStats local;
+	SearchStats& st = stats ? *stats : local;
+	if (n < 2)
+		return 0;
+
+	vector<int> order(n);
+	iota(order.begin(), order.end(), 0);
+	vector<KdNode> nodes;
+	build_kd(points, order, 0, n, true, nodes);
+
+	auto bound = [&](int a, int b) {
+		const KdNode& p = nodes[a];
+		const KdNode& q = nodes[b];
+		long long width = max(p.max_x - q.min_x, q.max_x - p.min_x) + 1;
+		long long height = max(p.max_y - q.min_y, q.max_y - p.min_y) + 1;
+		return width * height;
+	};
+
+	// (area or bound, a, b): a node pair when b >= 0 is a node, with a <= b
+	// in tree order; an exact vertex pair (a, ~b) otherwise. Exact pairs win
+	// ties, so an exact area on top is never beaten by what is still closed.
+	struct Entry {
+		long long key;
+		int a, b;
+		bool operator<(const Entry& o) const {
+			if (key != o.key)
+				return key < o.key;
+			return (b >= 0) > (o.b >= 0);
+		}
+	};
+	priority_queue<Entry> heap;
+	heap.push({ bound(0, 0), 0, 0 });
+
+	const long long BUDGET = 16LL * n + 4096;
+	while (!heap.empty()) {
+		Entry e = heap.top();
+		heap.pop();
+
+		if (e.b < 0) {
+			int i = e.a, j = ~e.b;
+			if (++st.candidates_validated > BUDGET) {
+				st.fell_back_to_scan = true;
+				return scan_pairs(points, grid, col, row, num_threads);
+			}
+			if (grid.count_outside(min(col[i], col[j]), max(col[i], col[j]),
+				min(row[i], row[j]), max(row[i], row[j])) == 0)
+				return e.key;
+			continue;
+		}
+
+		const KdNode& p = nodes[e.a];
+		const KdNode& q = nodes[e.b];
+		st.node_pairs_split++;
+		if (p.left < 0 && q.left < 0) {
+			for (int x = p.first; x < p.last; ++x) {
+				for (int y = (e.a == e.b ? x + 1 : q.first); y < q.last; ++y) {
+					int i = order[x], j = order[y];
+					long long width = abs(points[i].x - points[j].x) + 1;
+					long long height = abs(points[i].y - points[j].y) + 1;
+					heap.push({ width * height, i, ~j });
+				}
+			}
+		}
+		else if (e.a == e.b) {
+			int l = p.left, r = p.right;
+			heap.push({ bound(l, l), l, l });
+			heap.push({ bound(l, r), l, r });
+			heap.push({ bound(r, r), r, r });
+		}
+		else {
+			// Split the larger side; the other keeps its place.
+			bool split_p = q.left < 0 ||
+				(p.left >= 0 && p.last - p.first >= q.last - q.first);
+			int keep = split_p ? e.b : e.a;
+			const KdNode& s = split_p ? p : q;
+			for (int child : { s.left, s.right })
+				heap.push({ bound(child, keep), child, keep });
+		}
+	}
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
 	string filename = "input.txt";
-	if (argc > 1) {
-		filename = argv[1];
+	bool has_file = false;
+	bool raycast = false;
+	bool scan = false;
+	bool show_stats = false;
+	bool bench = false;
+	bool frontier = false;
+	int num_threads = max(1u, thread::hardware_concurrency());
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--raycast") {
+			raycast = true;
+		}
+		else if (arg == "--scan") {
+			scan = true;
+		}
+		else if (arg == "--stats") {
+			show_stats = true;
+		}
+		else if (arg == "--bench") {
+			bench = true;
+		}
+		else if (arg == "--frontier") {
+			frontier = true;
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			num_threads = max(1, stoi(argv[++i]));
+		}
+		else {
+			filename = arg;
+			has_file = true;
+		}
 	}
 
 	ifstream infile(filename);
 	istream* input = &cin;
-	if (filename != "input.txt" || argc > 1) {
+	if (has_file) {
 		if (!infile) {
 			cerr << "Error opening file: " << filename << endl;
 			return 1;
@@ -191,6 +864,25 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
+	if (bench) {
+		// Thread scaling of the pair scans, doubling up to --threads.
+		for (int t = 1;; t = min(2 * t, num_threads)) {
+			auto t0 = chrono::steady_clock::now();
+			long long p1 = solve_part1(points, t);
+			auto t1 = chrono::steady_clock::now();
+			long long p2 = solve_part2_scan(points, t);
+			auto t2 = chrono::steady_clock::now();
+			cout << t << " threads: part 1 " << p1 << " in "
+				<< chrono::duration<double, milli>(t1 - t0).count()
+				<< " ms, part 2 scan " << p2 << " in "
+				<< chrono::duration<double, milli>(t2 - t1).count() << " ms"
+				<< endl;
+			if (t == num_threads)
+				break;
+		}
+		return 0;
+	}
+
 	if (input == &cin)
 		cin.clear();
 	int part;
@@ -201,10 +893,31 @@ int main(int argc, char* argv[]) {
 	}
 
 	if (part == 1) {
-		cout << solve_part1(points) << endl;
+		if (frontier)
+			cout << solve_part1_frontier(points) << endl;
+		else
+			cout << solve_part1(points, num_threads) << endl;
 	}
 	else if (part == 2) {
-		cout << solve_part2(points) << endl;
+		if (raycast) {
+			cout << solve_part2_raycast(points) << endl;
+		}
+		else if (scan) {
+			cout << solve_part2_scan(points, num_threads) << endl;
+		}
+		else {
+			SearchStats stats;
+			cout << solve_part2(points, &stats, num_threads) << endl;
+			if (show_stats) {
+				long long pairs = (long long)points.size() *
+					(points.size() - 1) / 2;
+				cerr << "node pairs split: " << stats.node_pairs_split
+					<< ", candidates validated: "
+					<< stats.candidates_validated << " of " << pairs
+					<< (stats.fell_back_to_scan ? ", fell back to the scan" : "")
+					<< endl;
+			}
+		}
 	}
 	else {
 		cerr << "Invalid part selected." << endl;